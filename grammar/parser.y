@@ -53,6 +53,7 @@ procedures:
         procedureNode->proc_head = procHeadNode;
         procedureNode->declarations = declarationsNode;
         procedureNode->commands = commandsNode;
+        procedureNode->setPosition(@2.first_line, @2.first_column);
 
         ast::ProgramAllNode* programAllNode = dynamic_cast<ast::ProgramAllNode*>($1);
         programAllNode->procedures.push_back(procedureNode);
@@ -65,6 +66,7 @@ procedures:
         ast::CommandsNode* commandsNode = dynamic_cast<ast::CommandsNode*>($6);
         procedureNode->proc_head = procHeadNode;
         procedureNode->commands = commandsNode;
+        procedureNode->setPosition(@2.first_line, @2.first_column);
 
         ast::ProgramAllNode* programAllNode = dynamic_cast<ast::ProgramAllNode*>($1);
         programAllNode->procedures.push_back(procedureNode);
@@ -82,11 +84,13 @@ main:
         ast::MainNode* mainNode = new ast::MainNode();
         mainNode->declarations = dynamic_cast<ast::DeclarationsNode*>($3);
         mainNode->commands = dynamic_cast<ast::CommandsNode*>($5);
+        mainNode->setPosition(@1.first_line, @1.first_column);
         $$ = mainNode;
     }
     | PROGRAM IS EBEGIN commands END {
         ast::MainNode* mainNode = new ast::MainNode();
         mainNode->commands = dynamic_cast<ast::CommandsNode*>($4);
+        mainNode->setPosition(@1.first_line, @1.first_column);
         $$ = mainNode;
     }
     ;
@@ -111,6 +115,7 @@ command:
         ast::AssignmentNode* commandNode = new ast::AssignmentNode();
         commandNode->identifier = identifierNode;
         commandNode->expression = expressionNode;
+        commandNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = commandNode;
     }
@@ -123,6 +128,7 @@ command:
         ifStatementNode->condition = conditionNode;
         ifStatementNode->commands = commandsNodeIf;
         ifStatementNode->elseCommands = commandsNodeIfElse;
+        ifStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = ifStatementNode;
     }
@@ -133,6 +139,7 @@ command:
         ast::IfStatementNode* ifStatementNode = new ast::IfStatementNode();
         ifStatementNode->condition = conditionNode;
         ifStatementNode->commands = commandsNodeIf;
+        ifStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = ifStatementNode;
     }
@@ -143,6 +150,7 @@ command:
         ast::WhileStatementNode* whileStatementNode = new ast::WhileStatementNode();
         whileStatementNode->condition = conditionNode;
         whileStatementNode->commands = commandsNode;
+        whileStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = whileStatementNode;
     }
@@ -153,6 +161,7 @@ command:
         ast::RepeatStatementNode* repeatStatementNode = new ast::RepeatStatementNode();
         repeatStatementNode->condition = conditionNode;
         repeatStatementNode->commands = commandsNode;
+        repeatStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = repeatStatementNode;
     }
@@ -167,6 +176,7 @@ command:
         forStatementNode->valueFrom = valueNode1;
         forStatementNode->valueTo = valueNode2;
         forStatementNode->commands = commandsNode;
+        forStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = forStatementNode;
         free($2);
@@ -182,6 +192,7 @@ command:
         forStatementNode->valueFrom = valueNode1;
         forStatementNode->valueTo = valueNode2;
         forStatementNode->commands = commandsNode;
+        forStatementNode->setPosition(@1.first_line, @1.first_column);
 
         $$ = forStatementNode;
         free($2);
@@ -194,12 +205,14 @@ command:
         ast::IdentifierNode* identifierNode = dynamic_cast<ast::IdentifierNode*>($2);
         ast::ReadNode* readNode = new ast::ReadNode();
         readNode->identifier = identifierNode;
+        readNode->setPosition(@1.first_line, @1.first_column);
         $$ = readNode;
     }
     | WRITE value SEMICOLON {
         ast::ValueNode* valueNode = dynamic_cast<ast::ValueNode*>($2);
         ast::WriteNode* writeNode = new ast::WriteNode();
         writeNode->value = valueNode;
+        writeNode->setPosition(@1.first_line, @1.first_column);
         $$ = writeNode;
     }
     ;
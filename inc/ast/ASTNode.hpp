@@ -31,8 +31,8 @@ enum NodeType {
 };
 
 struct position {
-    int line;
-    int column;
+    int line = 0;
+    int column = 0;
 };
 
 class ASTNode {
@@ -0,0 +1,60 @@
+#ifndef CONSTANT_FOLDER_HPP
+#define CONSTANT_FOLDER_HPP
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+
+#include "AST.hpp"
+
+namespace ast {
+
+// Evaluates at compile time what the program computes from constants only.
+// An expression whose operands are both known becomes a single literal, a
+// known factor of a multiplication or a known divisor becomes a literal (the
+// generated code needs no loop for those) and an array index held by a
+// variable with a known value becomes a constant index. Values are followed through the structured
+// commands of main and of every procedure: IF keeps what both branches agree
+// on, loops forget what their body assigns. Only scalars declared in the
+// unit itself are followed; procedure parameters are references that may
+// alias each other, so they never are. Runs before semantic analysis, which
+// then sees the folded literals as any other.
+class ConstantFolder {
+   public:
+    void fold(ProgramAllNode *root);
+    long getFolded() const { return folded; }
+
+    // a op b as the generated code computes it; nothing if it overflows
+    static std::optional<long long> evaluate(MathOperation op, long long a,
+                                             long long b);
+
+   private:
+    using Values = std::map<std::string, long long>;
+
+    void foldUnit(ASTNode *declarations, ASTNode *commands);
+    void foldCommands(ASTNode *node, Values &values);
+    void foldCommand(ASTNode *node, Values &values);
+    void foldLoop(ASTNode *condition, ASTNode *commands, Values &values,
+                  bool conditionFirst);
+    void foldCondition(ASTNode *node, const Values &values);
+    bool worthFolding(MathOperation op, long long result) const;
+    std::optional<long long> foldExpression(ASTNode *node,
+                                            const Values &values);
+    std::optional<long long> foldValue(ASTNode *node, const Values &values);
+    void foldIndex(ASTNode *node, const Values &values);
+    void toLiteral(ASTNode *node, long long value);
+    void assignedIn(ASTNode *node, std::set<std::string> &names);
+    void collectLiterals(ASTNode *node);
+    static std::optional<long long> literal(const std::string &text);
+    std::optional<std::string> scalarName(ASTNode *identifier) const;
+
+    std::set<std::string> tracked;  // scalars of the current unit
+    std::set<long long> literals;   // used by the current unit
+    int loopDepth = 0;
+    long folded = 0;                // expressions and reads replaced
+};
+
+}  // namespace ast
+
+#endif  // CONSTANT_FOLDER_HPP
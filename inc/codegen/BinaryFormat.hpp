@@ -0,0 +1,39 @@
+#ifndef BINARY_FORMAT_HPP
+#define BINARY_FORMAT_HPP
+
+#include <cstdint>
+#include <string>
+
+// Binary program format (.mrb). The VM reads it with vm/mrb.hh, keep both
+// definitions in sync. Little-endian: one Header followed by `count`
+// fixed-width Records, opcodes numbered as in Opcode / vm/instructions.hh.
+namespace codegen::mrb {
+
+constexpr char MAGIC[4] = {'M', 'R', 'B', '\0'};
+constexpr uint32_t VERSION = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+struct Record {
+    uint32_t opcode;
+    uint32_t reserved;  // always 0
+    int64_t operand;
+};
+
+static_assert(sizeof(Header) == 16 && sizeof(Record) == 16,
+              "mrb layout must not depend on padding");
+
+inline bool isBinaryOutput(const std::string &fileName) {
+    const std::string extension = ".mrb";
+    return fileName.size() >= extension.size() &&
+           fileName.compare(fileName.size() - extension.size(),
+                            extension.size(), extension) == 0;
+}
+
+}  // namespace codegen::mrb
+
+#endif  // BINARY_FORMAT_HPP
@@ -1,7 +1,10 @@
 #ifndef CODE_GENERATOR_HPP
 #define CODE_GENERATOR_HPP
 
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "ASTNode.hpp"
@@ -11,13 +14,15 @@
 #include "InstructNodes.hpp"
 #include "Instructions.hpp"
 #include "Memory.hpp"
+#include "RuntimeLibrary.hpp"
 
 namespace codegen {
 
-struct Marker {
-    std::string name;
-    long line;
-    Marker(std::string &name, int &line) : name(name), line(line) {}
+// Source line and kind of code an emitted instruction comes from
+// (line 0: not tied to a source line).
+struct SourceOrigin {
+    int line;
+    const char *kind;
 };
 
 class CodeGenerator {
@@ -25,8 +30,16 @@ class CodeGenerator {
     CodeGenerator(compiler::Context &context);
     ~CodeGenerator();
     semana::ExitCode generateCode();
+    semana::ExitCode saveCode(std::vector<Instruction> code,
+                              std::vector<SourceOrigin> origins);
 
    private:
+    struct RuntimeJump {
+        LabelId label;
+        long line;
+        AssignOperation operation;
+    };
+
     void processNode(ASTNode *node);
     int getCurrentScope();
     void addCommand(std::string &symbolName, unsigned long &address);
@@ -34,19 +47,41 @@ class CodeGenerator {
     void addWrite(unsigned long &address);
     void addRead(unsigned long &address);
     void addAssign(std::vector<Instruction> &instructions);
+    void planRuntimeCalls();
+    void addRuntimeCall();
+    void addRuntimeLibrary();
     void addJumpIfAccIsTrue(int &jump);
     void setRValues();
     void jumpToMain();
+    void optimize();
     void saveInstructionsToFile();
-    unsigned long getFreeRegister();
-    long getMarkerForName(std::string &name);
+    RValueId internRValue(const std::string &text);
+    LabelId newLabel();
+    void setLabel(LabelId label, long distance);
+    long resolveLabel(const Label &label);
     void updateOpcode(Opcode &opcode);
+    void markPointer(unsigned long address);
+    bool isPointer(unsigned long address) const;
+    unsigned long leasePointer();
+    void releaseStatementTemps();
+    Opcode accessThrough(Opcode opcode, unsigned long address);
     bool isProcArgument(std::string &argName, int &scope);
+    bool beginSource(ASTNode *node);
+    void beginSource(int line, const char *kind);
+    void endSource();
+    void setSourceKind(const char *kind);
+    void syncSourceMap();
+    void saveSourceMap();
 
 
     semana::ExitCode exitCode;
     std::vector<Instruction> instructions;
-    std::vector<Marker> markers;  // used to mark procedures - when they start
+    std::vector<std::string> rvalueTexts;  // literal -> source text
+    std::unordered_map<std::string, RValueId> rvalueIds;
+    std::vector<std::optional<long>> labels;  // label -> jump distance
+    std::unordered_map<std::string, long> procedures;  // name -> first line
+    LabelId mainLabel;
+    int jumpToMainLine;
     int lineCounter;
     Command currentCommand;
     std::string currentProcName;
@@ -58,13 +93,15 @@ class CodeGenerator {
     WhileNode whileNode;
     ForNode forNode;
     Memory memory;
-    int noConditions;
-    int noRepeats;
-    int noWhiles;   // wrap these counters and nodes into struct
-    int noFors;
-    std::vector<unsigned long> heap;
-    std::unordered_map<unsigned long, unsigned long> arrayPointers;
+    std::vector<bool> pointers;  // by cell address
     std::string currProcCallName;
+    std::vector<SourceOrigin> sourceMap;    // parallel to instructions
+    std::vector<SourceOrigin> sourceStack;  // statements being generated
+    std::vector<std::vector<TempCell>> statementTemps;  // of open statements
+    RuntimeLibrary runtime;
+    std::unordered_set<ASTNode *> runtimeCalls;  // assignments calling it
+    bool callRuntime = false;                    // for the current one
+    std::vector<RuntimeJump> runtimeJumps;
 };
 
 }  // namespace codegen
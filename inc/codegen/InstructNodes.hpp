@@ -41,7 +41,7 @@ class Node {
     unsigned long identifier1;
     unsigned long identifier2;
     bool codeGenerated;
-    std::string name;
+    LabelId label;  // where the generated jumps go
 
    protected:
     int steps;  // counter how many vars we already have - if 2 then generate
@@ -58,8 +58,14 @@ class AssignNode : public Node {
     void clear();
 
     std::optional<unsigned long> identifier3;
+    std::optional<long long> constant2;  // value of identifier2 if a literal
+    std::optional<long long> constant3;  // value of identifier3 if a literal
     AssignOperation operation;
     bool waitForThirdArg;
+
+   private:
+    bool multiplyByConstant();
+    bool divideByConstant(bool remainder);
 };
 
 class ConditionNode : public Node {
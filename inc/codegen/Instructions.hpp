@@ -1,10 +1,12 @@
 #ifndef INSTRUCTIONS_HPP
 #define INSTRUCTIONS_HPP
 
+#include <cstdint>
 #include <ostream>
+#include <type_traits>
 #include <vector>
 
-enum Opcode {
+enum Opcode : uint8_t {
     GET,
     PUT,
     LOAD,
@@ -26,27 +28,57 @@ enum Opcode {
     UNDEFINED
 };
 
-enum InstructionMode {
+enum InstructionMode : uint8_t {
     VALUE,
     LABEL,
     RVALUE,
+    LINE,  // absolute instruction index (return line of a call)
 };
 
+using LabelId = int;
+using RValueId = long;  // index into the pool of literal texts
+
+// Jump target: distance stored for the label once the code it jumps over is
+// generated, plus a fixed number of instructions more (e.g. 1 for the first
+// of two conditional jumps to the same place).
+struct Label {
+    LabelId id;
+    int offset = 0;
+};
+
+// 16-byte record, copied around by value. Labels and literals are not
+// stored inline: value is the cell or jump distance (VALUE), the label id
+// (LABEL, with offset), the index of the literal (RVALUE) or an instruction
+// index (LINE).
 class Instruction {
    public:
     Opcode opcode;
-    long value;
-    std::string label;
     InstructionMode mode;
     bool doNotModify;
+    int32_t offset;
+    long value;
 
+    Instruction() = default;
     Instruction(Opcode opcode, long value = 0)
-        : opcode(opcode), value(value), mode(VALUE), doNotModify(false), label("") {}
-    Instruction(Opcode opcode, std::string& label,
-                InstructionMode mode = LABEL)  // constructor for label jump
-        : opcode(opcode), label(label), mode(mode), doNotModify(false), value(0) {}
+        : opcode(opcode), mode(VALUE), doNotModify(false), offset(0), value(value) {}
+    Instruction(Opcode opcode, Label target)  // constructor for label jump
+        : opcode(opcode), mode(LABEL), doNotModify(false), offset(target.offset), value(target.id) {}
     Instruction(Opcode opcode, long value, bool doNotModify)
-        : opcode(opcode), value(value), mode(VALUE), doNotModify(doNotModify), label("") {}
+        : opcode(opcode), mode(VALUE), doNotModify(doNotModify), offset(0), value(value) {}
+
+    static Instruction rvalue(Opcode opcode, RValueId literal) {  // SET of a literal
+        Instruction instruction(opcode, literal);
+        instruction.mode = RVALUE;
+        return instruction;
+    }
+
+    static Instruction line(Opcode opcode, long line) {  // SET of a return line
+        Instruction instruction(opcode, line);
+        instruction.mode = LINE;
+        return instruction;
+    }
+
+    Label target() const { return {static_cast<LabelId>(value), offset}; }
 
     static long getExecutionTime(Opcode opcode) {
         return executionTimes[opcode];
@@ -56,6 +88,10 @@ class Instruction {
     static const std::vector<long> executionTimes;
 };
 
+static_assert(sizeof(Instruction) == 16 && std::is_trivial<Instruction>::value &&
+                  std::is_standard_layout<Instruction>::value,
+              "Instruction should stay a 16-byte POD");
+
 inline std::ostream& operator<<(std::ostream& os, const Opcode& opcode) {
     switch (opcode) {
         case GET:
@@ -1,34 +1,50 @@
 #ifndef MEMORY_HPP
 #define MEMORY_HPP
 
-#include <stdexcept>
-#include <unordered_map>
-#include <iostream>
 #include <limits>
+#include <stdexcept>
+#include <vector>
 
 namespace codegen {
 
-class Register {
-   public:
-    Register(unsigned long address);
-    void lock();
-    void unlock();
-
-    unsigned long address;
-    bool isLocked;  // if true then memory class won't return it as free register
-};
-
+// Temporary cells above the variables. Released cells are kept on a stack
+// and handed out again first, so the number of cells in use is bounded by
+// the temporaries alive at once, not by the size of the program.
 class Memory {
    public:
     Memory() = default;
     Memory(unsigned long lastUsedAddress);
-    void unlockReg(const unsigned long &regAddr);
-    void lockReg(const unsigned long &regAddr);
-    unsigned long& getFreeRegister();
+
+    // highest cell handed out so far
+    unsigned long lastUsedAddress() const { return firstFreeAddr - 1; }
 
    private:
+    friend class TempCell;
+
+    unsigned long acquire();
+    void release(unsigned long address);
+
     unsigned long firstFreeAddr;
-    std::unordered_map<unsigned long, Register> registers;
+    std::vector<unsigned long> freeCells;
+};
+
+// Lease of a temporary cell: it is taken from memory on construction and
+// given back when the lease is destroyed.
+class TempCell {
+   public:
+    explicit TempCell(Memory &memory);
+    TempCell(TempCell &&other) noexcept;
+    TempCell(const TempCell &) = delete;
+    TempCell &operator=(const TempCell &) = delete;
+    TempCell &operator=(TempCell &&) = delete;
+    ~TempCell();
+
+    operator unsigned long() const { return address; }
+
+    unsigned long address;
+
+   private:
+    Memory *memory;
 };
 
 }  // namespace codegen
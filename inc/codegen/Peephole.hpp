@@ -0,0 +1,96 @@
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "CodeGenerator.hpp"
+#include "Instructions.hpp"
+
+namespace codegen {
+
+struct PeepholeStats {
+    const char *rule;
+    long applied = 0;
+    long instructions = 0;  // removed
+    long cost = 0;          // sum of base execution times removed
+};
+
+// Rewrites the final instruction vector with a table of sliding-window
+// rules, repeated until none applies. Jumps are followed by target while
+// rewriting (labels must be resolved before), so relative offsets and
+// return lines stay right. A window only matches when no jump lands inside
+// it, past its first instruction.
+class PeepholeOptimizer {
+   public:
+    // rules: comma separated names, "all" or "none"; cells from
+    // firstScratchCell up are the compiler's temporaries, constantCells
+    // hold literals. Neither is ever reached through a pointer.
+    PeepholeOptimizer(const std::string &rules, unsigned long firstScratchCell,
+                      std::vector<unsigned long> constantCells = {});
+    void run(std::vector<Instruction> &instructions,
+             std::vector<SourceOrigin> &sourceMap);
+    void printReport(std::ostream &os) const;
+
+    static std::vector<std::string> ruleNames();
+    static bool validRules(const std::string &rules);
+
+   private:
+    struct Slot {
+        Instruction instruction;
+        SourceOrigin origin;
+        long target;  // absolute instruction index of a jump or LINE, or -1
+    };
+
+    using Match = bool (PeepholeOptimizer::*)(const std::vector<Slot> &code,
+                                              size_t at,
+                                              std::vector<Instruction> &out);
+    struct Rule {
+        const char *name;
+        size_t window;
+        Match match;
+    };
+
+    static const std::vector<Rule> rules;
+
+    bool pass(std::vector<Slot> &code);
+    void findReadCells(const std::vector<Slot> &code);
+    void trackAccumulator(const std::vector<Slot> &code,
+                          const std::vector<bool> &isTarget);
+    bool isScratch(unsigned long cell) const;
+    bool isUnread(unsigned long cell) const;
+    unsigned long constantOne();
+
+    bool storeLoad(const std::vector<Slot> &code, size_t at,
+                   std::vector<Instruction> &out);
+    bool loadStore(const std::vector<Slot> &code, size_t at,
+                   std::vector<Instruction> &out);
+    bool deadAccumulator(const std::vector<Slot> &code, size_t at,
+                         std::vector<Instruction> &out);
+    bool redundantAccumulator(const std::vector<Slot> &code, size_t at,
+                              std::vector<Instruction> &out);
+    bool deadStore(const std::vector<Slot> &code, size_t at,
+                   std::vector<Instruction> &out);
+    bool jumpToNext(const std::vector<Slot> &code, size_t at,
+                    std::vector<Instruction> &out);
+    bool forStepUp(const std::vector<Slot> &code, size_t at,
+                   std::vector<Instruction> &out);
+    bool forStepDown(const std::vector<Slot> &code, size_t at,
+                     std::vector<Instruction> &out);
+
+    std::vector<bool> enabled;  // by rule
+    std::vector<PeepholeStats> stats;
+    unsigned long firstScratchCell;
+    unsigned long nextFreeCell = 0;
+    unsigned long oneCell = 0;      // cell set to 1 at the start, 0 if none
+    std::vector<bool> readCells;    // scratch cells read anywhere, by offset
+    std::unordered_set<unsigned long> constantCells;
+    std::unordered_set<unsigned long> readConstants;  // read anywhere
+    std::vector<bool> redundant;    // by instruction, from trackAccumulator
+};
+
+}  // namespace codegen
+
+#endif  // PEEPHOLE_HPP
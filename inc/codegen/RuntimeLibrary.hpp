@@ -0,0 +1,73 @@
+#ifndef RUNTIME_LIBRARY_HPP
+#define RUNTIME_LIBRARY_HPP
+
+#include <map>
+#include <vector>
+
+#include "InstructNodes.hpp"
+#include "Instructions.hpp"
+#include "Memory.hpp"
+
+namespace codegen {
+
+// Multiplication, division or remainder computed by the loop kernels, with
+// the number of loops around it (a procedure counts the loops it is called
+// from as well).
+struct ArithmeticSite {
+    AssignOperation operation;
+    int loopDepth;
+};
+
+// Out-of-line copies of the multiplication, division and remainder kernels,
+// emitted once after the program and shared by their call sites. A call
+// stores the operands straight into the cells the kernel starts from and
+// the return line in the return cell of the routine, jumps to it and stores
+// the accumulator it comes back with: 8 instructions instead of 50-130, for
+// about 70 more cost each time it runs (SET, STORE, JUMP and RTRN).
+class RuntimeLibrary {
+   public:
+    explicit RuntimeLibrary(long inlineLimit = DEFAULT_INLINE_LIMIT);
+
+    // Chooses for every site whether it calls a routine and generates the
+    // routines called, their cells taken from memory. Kernels are inlined
+    // deepest loop first while they add up to at most inlineLimit
+    // instructions; an operation called from one site only is inlined there.
+    std::vector<bool> plan(const std::vector<ArithmeticSite> &sites,
+                           Memory &memory);
+
+    // result := left op right; LOAD left, LOAD right and STORE result are
+    // to be redirected through pointers by the caller. The JUMP, last but
+    // one, still has to be pointed at start(operation).
+    std::vector<Instruction> call(AssignOperation operation,
+                                  unsigned long result, unsigned long left,
+                                  unsigned long right, long firstLine) const;
+
+    // Lays the routines out from firstLine on, each ending with RTRN.
+    std::vector<Instruction> place(long firstLine);
+    long start(AssignOperation operation) const;
+
+    static const long DEFAULT_INLINE_LIMIT = 1000;
+
+   private:
+    struct Routine {
+        std::vector<Instruction> code;
+        unsigned long left;
+        unsigned long right;
+        unsigned long returnCell;
+        long start = -1;
+    };
+
+    static std::vector<Instruction> kernel(AssignOperation operation,
+                                           Memory &memory,
+                                           unsigned long result,
+                                           unsigned long left,
+                                           unsigned long right);
+    void generate(AssignOperation operation, Memory &memory);
+
+    long inlineLimit;
+    std::map<AssignOperation, Routine> routines;
+};
+
+}  // namespace codegen
+
+#endif  // RUNTIME_LIBRARY_HPP
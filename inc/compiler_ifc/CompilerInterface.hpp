@@ -6,14 +6,26 @@
 #include "SemanticAnalzyer.hpp"
 #include "CodeGenerator.hpp"
 #include "Context.hpp"
+#include "RuntimeLibrary.hpp"
 
 namespace compiler {
 
+struct Options {
+    std::string mapFile;  // source map sidecar, empty if not requested
+    std::string irFile;   // IR dump, empty if not requested
+    bool viaIr = false;   // generate code by lowering the IR
+    bool constantFolding = true;  // evaluate constant expressions first
+    std::string peepholeRules = "all";  // comma separated, "all" or "none"
+    bool peepholeReport = false;        // print what each rule removed
+    long inlineLimit = codegen::RuntimeLibrary::DEFAULT_INLINE_LIMIT;
+};
+
 class Compiler {
     Context context;
 
    public:
-    semana::ExitCode compile(ast::ProgramAllNode* astRoot, std::string& inputFile, std::string& outputFile);
+    semana::ExitCode compile(ast::ProgramAllNode* astRoot, std::string& inputFile, std::string& outputFile,
+                             const Options& options = Options());
 };
 }  // namespace compiler
 
@@ -2,6 +2,7 @@
 #define CONTEXT_HPP
 
 #include "ProgramAllNode.hpp"
+#include "RuntimeLibrary.hpp"
 #include "SymbolTable.hpp"
 
 namespace compiler {
@@ -11,6 +12,13 @@ public:
     ast::ProgramAllNode* astRoot = nullptr;
     semana::SymbolTable symbolTable;
     std::string outputFile;
+    std::string mapFile;  // source map sidecar, empty if not requested
+    std::string irFile;   // IR dump, empty if not requested
+    bool viaIr = false;   // generate code by lowering the IR
+    std::string peepholeRules = "all";  // comma separated, "all" or "none"
+    bool peepholeReport = false;
+    // instructions of arithmetic kernels inlined
+    long inlineLimit = codegen::RuntimeLibrary::DEFAULT_INLINE_LIMIT;
 
     Context() = default;
     ~Context() = default;
@@ -0,0 +1,52 @@
+#ifndef COST_HPP
+#define COST_HPP
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace costan {
+
+// Interval of non-negative costs; saturates instead of overflowing.
+struct Range {
+    long long min = 0;
+    long long max = 0;
+
+    bool exact() const { return min == max; }
+};
+
+// Cost of a piece of code as a polynomial over loop trip counts: every
+// term is a range coefficient times a product of loop symbols (n1, n2, ...;
+// the empty product is the constant part). All symbols are >= 0, so taking
+// the coefficient-wise hull of two costs bounds both of them.
+class Cost {
+   public:
+    using Monomial = std::vector<int>;  // sorted loop symbols
+
+    Cost() = default;
+    explicit Cost(long long constant);
+
+    Cost &operator+=(const Cost &other);
+    Cost times(long long factor) const;
+    Cost timesSymbol(int symbol) const;
+    Cost hull(const Cost &other) const;
+
+    // Cost of code that may loop forever (irreducible flow, recursion).
+    static Cost unbounded();
+
+    bool isUnbounded() const { return noUpperBound; }
+    bool exact() const;
+    Range constant() const;
+    const std::map<Monomial, Range> &getTerms() const { return terms; }
+
+   private:
+    std::map<Monomial, Range> terms;
+    bool noUpperBound = false;
+};
+
+std::ostream &operator<<(std::ostream &os, const Range &range);
+std::ostream &operator<<(std::ostream &os, const Cost &cost);
+
+}  // namespace costan
+
+#endif  // COST_HPP
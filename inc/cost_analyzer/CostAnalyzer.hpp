@@ -0,0 +1,109 @@
+#ifndef COST_ANALYZER_HPP
+#define COST_ANALYZER_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Cost.hpp"
+#include "Program.hpp"
+
+namespace costan {
+
+struct LoopReport {
+    int symbol;  // n<symbol> in costs, also when the trip count is known
+    size_t first;
+    size_t last;  // instruction range of the loop body
+    bool forLoop;
+    bool tripCountKnown;
+    long long tripCount;
+    Cost iteration;  // one pass from the header back to it
+    Cost total;
+};
+
+struct ProcedureReport {
+    size_t entry;
+    Cost cost;  // from the entry to RTRN
+};
+
+struct CostReport {
+    size_t instructions = 0;
+    size_t blocks = 0;
+    std::vector<LoopReport> loops;
+    std::vector<ProcedureReport> procedures;
+    Cost total;
+};
+
+// Static cost of a program, in Instruction::getExecutionTime units.
+// The program is split into basic blocks and analysed per procedure (a
+// call is SET <return>; STORE <cell>; JUMP <procedure>). Loop-free code
+// gets the range of its path costs, which is exact when there is a single
+// path. Natural loops are collapsed innermost first into
+// exit + iterations * iteration. FOR loops whose bounds are constants get
+// their exact trip count; any other loop keeps a symbol n<k>.
+class CostAnalyzer {
+   public:
+    explicit CostAnalyzer(const Program &program);
+    CostReport analyze();
+
+   private:
+    struct Block {
+        size_t first;
+        size_t last;
+        long long cost;
+        std::vector<size_t> successors;
+        bool terminal = false;  // HALT, RTRN or a jump out of the program
+        bool call = false;
+        size_t callee = 0;
+    };
+
+    // Blocks of one procedure (or of the main program) being analysed.
+    struct Region {
+        std::vector<size_t> order;     // reverse postorder from the entry
+        std::vector<size_t> position;  // index in order, NONE if unreachable
+        std::vector<size_t> idom;
+        std::vector<size_t> rep;  // block -> collapsed loop containing it
+        std::vector<Cost> cost;
+        std::vector<std::vector<size_t>> successors;
+        std::vector<bool> terminal;
+        bool irreducible = false;
+    };
+
+    struct PathCosts {
+        Cost toStart;  // paths that come back to the start node
+        Cost toExit;   // paths that leave the node set or terminate
+        bool cyclic = false;
+    };
+
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+
+    void buildBlocks();
+    bool isCall(size_t index) const;
+    long long target(size_t index) const;
+    Cost analyzeRegion(size_t entry);
+    Cost procedureCost(size_t entry);
+    void computeDominators(Region &region, size_t entry) const;
+    bool dominates(const Region &region, size_t a, size_t b) const;
+    size_t find(const Region &region, size_t block) const;
+    PathCosts pathCosts(const Region &region, size_t start,
+                        const std::set<size_t> &members) const;
+    LoopReport collapseLoop(Region &region, size_t header,
+                            const std::set<size_t> &body);
+    void classifyLoop(const Region &region, size_t header,
+                      const std::set<size_t> &body, LoopReport &loop) const;
+    bool constantCell(const Region &region, long long cell, size_t header,
+                      long long &value, int depth = 0) const;
+
+    const Program &program;
+    std::vector<Block> blocks;
+    std::vector<size_t> blockOf;
+    std::map<long long, std::vector<size_t>> stores;  // cell -> STORE indices
+    std::set<long long> addressTaken;                 // SET operands
+    std::map<size_t, Cost> procedures;
+    std::set<size_t> inProgress;
+    CostReport report;
+};
+
+}  // namespace costan
+
+#endif  // COST_ANALYZER_HPP
@@ -0,0 +1,26 @@
+#ifndef PROGRAM_HPP
+#define PROGRAM_HPP
+
+#include <string>
+#include <vector>
+
+#include "Instructions.hpp"
+
+namespace costan {
+
+// One resolved VM instruction as written to .mr/.mrb (jump operands are
+// relative, RTRN reads its target from memory).
+struct ProgramInstruction {
+    Opcode opcode;
+    long long operand;
+};
+
+using Program = std::vector<ProgramInstruction>;
+
+// Reads a text (.mr) or binary (.mrb) program; throws std::runtime_error
+// on malformed input.
+Program readProgram(const std::string &fileName);
+
+}  // namespace costan
+
+#endif  // PROGRAM_HPP
@@ -0,0 +1,99 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ir {
+
+// Three-address code over the memory cells of the program. Operands are
+// cells of variables, temporaries of the function, constants or addresses
+// of variables (passed to procedures or used as array bases); cells and
+// temporaries may be dereferenced when they hold an address.
+enum class OperandKind : uint8_t { NONE, CELL, TEMP, CONST, ADDR };
+
+struct Operand {
+    OperandKind kind = OperandKind::NONE;
+    bool indirect = false;
+    long long value = 0;  // address, temporary number or constant
+
+    static Operand cell(long long address);
+    static Operand temp(int number);
+    static Operand constant(long long value);
+    static Operand address(long long address);
+    Operand deref() const;
+
+    bool isNone() const { return kind == OperandKind::NONE; }
+    bool operator==(const Operand &other) const;
+};
+
+enum class Op : uint8_t { COPY, ADD, SUB, MUL, DIV, MOD, READ, WRITE, CALL };
+
+// dst = a, dst = a op b, read dst, write a, call callee(args).
+struct Instr {
+    Op op;
+    Operand dst;
+    Operand a;
+    Operand b;
+    int callee = -1;  // index of the function in the module
+    std::vector<Operand> args;
+    int line = 0;
+    const char *kind = "other";  // as in the source map
+    int loopDepth = 0;           // loops around it in its function
+};
+
+enum class Relation : uint8_t { EQ, NEQ, LT, LE, GT, GE };
+
+enum class Exit : uint8_t { JUMP, BRANCH, RETURN, HALT };
+
+// Last instruction of a block: goto target, if a relation b then target
+// else otherwise, return from the procedure or halt.
+struct Terminator {
+    Exit exit = Exit::HALT;
+    Relation relation = Relation::EQ;
+    Operand a;
+    Operand b;
+    int target = -1;
+    int otherwise = -1;
+    int line = 0;
+    const char *kind = "other";
+};
+
+struct BasicBlock {
+    int id;
+    std::vector<Instr> code;
+    Terminator exit;
+
+    std::vector<int> successors() const;
+};
+
+// Blocks are kept in layout order, the entry first.
+struct Function {
+    std::string name;
+    long long returnCell = 0;         // cell with the return line, procedures only
+    std::vector<long long> params;    // cells receiving the argument addresses
+    std::vector<std::string> paramNames;
+    std::vector<BasicBlock> blocks;
+    int firstTemp = 0;  // temporaries of different functions never overlap
+    int temps = 0;
+    int line = 0;
+};
+
+// Procedures in declaration order, then main.
+struct Module {
+    std::vector<Function> functions;
+    std::map<long long, std::string> names;  // cell -> variable, for printing
+    int temps = 0;
+
+    const Function &main() const { return functions.back(); }
+};
+
+void print(std::ostream &os, const Module &module);
+std::ostream &operator<<(std::ostream &os, Relation relation);
+
+}  // namespace ir
+
+#endif  // IR_HPP
@@ -0,0 +1,65 @@
+#ifndef IR_BUILDER_HPP
+#define IR_BUILDER_HPP
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Context.hpp"
+#include "IR.hpp"
+
+namespace ir {
+
+// Builds the IR of a checked program. Every statement becomes three-address
+// instructions in the current block; IF, WHILE, REPEAT and FOR split the
+// code into blocks. Temporaries (array element addresses, FOR bounds) are
+// released at the end of the statement that needs them, like the scratch
+// cells of the code generator.
+class IRBuilder {
+   public:
+    explicit IRBuilder(compiler::Context &context);
+    Module build();
+
+   private:
+    void buildProcedure(ASTNode *node);
+    void buildMain(ASTNode *node);
+    void beginFunction(Function &function);
+    void endFunction();
+    void buildCommands(ASTNode *node);
+    void buildCommand(ASTNode *node);
+    void buildFor(std::string &iterator, ASTNode *from, ASTNode *to,
+                  ASTNode *commands, bool downto);
+    void branch(ASTNode *condition, int target, int otherwise);
+    Operand value(ASTNode *node);
+    Operand identifier(ASTNode *node);
+    Operand variable(std::string name);
+    void emit(Instr instr);
+    void setExit(Terminator exit);
+    int newBlock();
+    void startBlock(int block);
+    void jumpTo(int block);
+    int newTemp();
+    void beginStatement(int line, const char *kind);
+    void endStatement();
+    void setKind(const char *kind);
+    bool isArgument(std::string name);
+    int scope();
+
+    compiler::Context &context;
+    Module module;
+    std::string procName;
+    Function *function = nullptr;
+    int current = -1;                 // block receiving instructions
+    int loopDepth = 0;                // loops around the current statement
+    std::vector<int> layout;          // blocks in the order they are started
+    std::vector<int> freeTemps;
+    std::vector<std::vector<int>> statementTemps;  // of open statements
+    std::vector<std::pair<int, const char *>> origins;  // line, kind
+    std::unordered_map<std::string, int> functionIndex;
+};
+
+}  // namespace ir
+
+#endif  // IR_BUILDER_HPP
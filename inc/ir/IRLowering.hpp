@@ -0,0 +1,77 @@
+#ifndef IR_LOWERING_HPP
+#define IR_LOWERING_HPP
+
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+#include "CodeGenerator.hpp"
+#include "IR.hpp"
+#include "Instructions.hpp"
+#include "Memory.hpp"
+#include "RuntimeLibrary.hpp"
+
+namespace ir {
+
+struct LoweredCode {
+    std::vector<Instruction> instructions;
+    std::vector<codegen::SourceOrigin> sourceMap;  // parallel to instructions
+};
+
+// Lowers the IR to machine instructions. Constants get cells set up before
+// main, temporaries of the IR get the cells after them and the scratch cells
+// of multiplication and division kernels come from a Memory above those.
+// Blocks are laid out in order: jumps to the next block are left out and
+// jumps to blocks holding nothing but a jump go straight to the end of the
+// chain. Main comes first, then the procedures and the shared routines of
+// the multiplications and divisions not inlined.
+class IRLowering {
+   public:
+    IRLowering(const Module &module, unsigned long firstFreeAddress,
+               long inlineLimit = codegen::RuntimeLibrary::DEFAULT_INLINE_LIMIT);
+    LoweredCode lower();
+
+   private:
+    struct Fixup {
+        size_t instruction;
+        size_t function;
+        int block;  // -1: entry of the function
+    };
+    struct RuntimeJump {
+        size_t instruction;
+        codegen::AssignOperation operation;
+    };
+
+    void collectConstants();
+    void planRuntimeCalls();
+    void lowerFunction(size_t index);
+    void lowerInstr(const Instr &instr);
+    void lowerKernel(const Instr &instr);
+    void lowerCall(const Instr &instr);
+    void lowerExit(size_t function, const Terminator &exit, int next);
+    int follow(const Function &function, int block) const;
+    bool isSkipped(const Function &function, int block) const;
+    unsigned long cellOf(const Operand &operand) const;
+    void load(const Operand &operand);
+    void apply(Opcode opcode, const Operand &operand);
+    void store(const Operand &operand);
+    void jumpTo(Opcode opcode, size_t function, int block);
+    void emit(Opcode opcode, long value = 0);
+
+    const Module &module;
+    unsigned long firstFreeAddress;
+    unsigned long firstTempAddress;
+    std::map<long long, unsigned long> constants;  // value -> cell
+    codegen::Memory memory;
+    std::vector<std::vector<long>> blockStart;  // function, block -> line
+    std::vector<Fixup> fixups;
+    codegen::RuntimeLibrary runtime;
+    std::unordered_set<const Instr *> runtimeCalls;
+    std::vector<RuntimeJump> runtimeJumps;
+    codegen::SourceOrigin origin;
+    LoweredCode code;
+};
+
+}  // namespace ir
+
+#endif  // IR_LOWERING_HPP
@@ -7,6 +7,7 @@
 #include "Parser.hpp"
 #include "ProgramAllNode.hpp"
 #include "CompilerInterface.hpp"
+#include "Peephole.hpp"
 
 static yyFlexLexer lexer;
 
@@ -15,16 +16,55 @@ int yylex() { return lexer.yylex(); }
 extern ast::ProgramAllNode* astRoot;
 
 int main(int argc, char** argv) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>\n";
+    compiler::Options options;
+    bool writeMap = false;
+    bool dumpIr = false;
+    int firstArg = 1;
+    for (; firstArg < argc && argv[firstArg][0] == '-'; firstArg++) {
+        std::string option = argv[firstArg];
+        if (option == "--map") {
+            writeMap = true;
+        } else if (option == "--no-fold") {
+            options.constantFolding = false;
+        } else if (option == "--ir") {
+            options.viaIr = true;
+        } else if (option == "--dump-ir") {
+            dumpIr = true;
+        } else if (option.rfind("--peephole=", 0) == 0) {
+            options.peepholeRules = option.substr(std::string("--peephole=").size());
+            if (!codegen::PeepholeOptimizer::validRules(options.peepholeRules)) {
+                std::cerr << "Unknown peephole rule in " << option << ", rules:";
+                for (auto& rule : codegen::PeepholeOptimizer::ruleNames()) std::cerr << ' ' << rule;
+                std::cerr << "\n";
+                return 1;
+            }
+        } else if (option == "--peephole-report") {
+            options.peepholeReport = true;
+        } else if (option.rfind("--inline-limit=", 0) == 0) {
+            std::string limit = option.substr(std::string("--inline-limit=").size());
+            if (limit.empty() || limit.find_first_not_of("0123456789") != std::string::npos) {
+                std::cerr << "Expected a number of instructions in " << option << "\n";
+                return 1;
+            }
+            options.inlineLimit = std::stol(limit);
+        } else {
+            break;
+        }
+    }
+    if (argc - firstArg != 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--map] [--no-fold] [--ir] [--dump-ir] [--peephole=<rules>|all|none] [--peephole-report] [--inline-limit=<n>]"
+                     " <input_file> <output_file>\n";
         return 1;
     }
 
-    std::string inputFilename = argv[1];
-    std::string outputFilename = argv[2];
+    std::string inputFilename = argv[firstArg];
+    std::string outputFilename = argv[firstArg + 1];
+    if (writeMap) options.mapFile = outputFilename + ".map";
+    if (dumpIr) options.irFile = outputFilename + ".ir";
     std::ifstream file(inputFilename);
     if (!file.is_open()) {
-        std::cerr << "Could not open file " << argv[1] << "\n";
+        std::cerr << "Could not open file " << inputFilename << "\n";
         return 1;
     }
 
@@ -36,7 +76,7 @@ int main(int argc, char** argv) {
 
     std::cout << "Starting compiler ...\n";
     compiler::Compiler compiler;
-    semana::ExitCode exitCode = compiler.compile(astRoot, inputFilename, outputFilename);
+    semana::ExitCode exitCode = compiler.compile(astRoot, inputFilename, outputFilename, options);
     std::cout << "Compiler finished with exit code " << exitCode << ".\n";
 
     return exitCode;
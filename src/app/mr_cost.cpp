@@ -0,0 +1,50 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "CostAnalyzer.hpp"
+#include "Program.hpp"
+
+static void printLoop(const costan::LoopReport &loop) {
+    std::cout << "  n" << loop.symbol << "  [" << loop.first << ".." << loop.last
+              << "] " << (loop.forLoop ? "FOR" : "loop");
+    if (loop.tripCountKnown)
+        std::cout << ", " << loop.tripCount << " iterations";
+    else if (loop.forLoop)
+        std::cout << ", trip count not constant";
+    std::cout << ": iteration " << loop.iteration << ", total " << loop.total
+              << "\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <program.mr|program.mrb>\n";
+        return 1;
+    }
+
+    costan::Program program;
+    try {
+        program = costan::readProgram(argv[1]);
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    costan::CostAnalyzer analyzer(program);
+    costan::CostReport report = analyzer.analyze();
+
+    std::cout << argv[1] << ": " << report.instructions << " instructions, "
+              << report.blocks << " basic blocks\n";
+    if (!report.loops.empty()) {
+        std::cout << "loops:\n";
+        for (auto &loop : report.loops) printLoop(loop);
+    }
+    if (!report.procedures.empty()) {
+        std::cout << "procedures:\n";
+        for (auto &procedure : report.procedures)
+            std::cout << "  at " << procedure.entry << ": " << procedure.cost
+                      << "\n";
+    }
+    std::cout << "cost: " << report.total
+              << (report.total.exact() ? " (exact)" : "") << "\n";
+    return 0;
+}
@@ -0,0 +1,426 @@
+#include "ConstantFolder.hpp"
+
+#include <stdexcept>
+
+#include "ASTNodeFactory.hpp"
+
+namespace ast {
+
+void ConstantFolder::fold(ProgramAllNode *root) {
+    if (root == nullptr) return;  // parse error, reported by the analyzer
+    for (auto &procedure : root->procedures) {
+        auto proceduresNode = ASTNodeFactory::castNode<ProceduresNode>(procedure);
+        foldUnit(proceduresNode->declarations.value_or(nullptr),
+                 proceduresNode->commands);
+    }
+    auto mainNode = ASTNodeFactory::castNode<MainNode>(root->main);
+    foldUnit(mainNode->declarations, mainNode->commands);
+}
+
+// Division truncates towards zero and the remainder takes the sign of the
+// divisor, like the DIVIDE and MOD kernels; both give 0 for a zero divisor.
+std::optional<long long> ConstantFolder::evaluate(MathOperation op,
+                                                  long long a, long long b) {
+    long long result;
+    switch (op) {
+        case PLUS:
+            if (__builtin_add_overflow(a, b, &result)) return std::nullopt;
+            return result;
+        case SUBSTRACT:
+            if (__builtin_sub_overflow(a, b, &result)) return std::nullopt;
+            return result;
+        case MULTIPLY:
+            if (__builtin_mul_overflow(a, b, &result)) return std::nullopt;
+            return result;
+        case DIVIDE:
+            if (b == 0) return 0;
+            if (b == -1) {
+                if (__builtin_sub_overflow(0LL, a, &result)) return std::nullopt;
+                return result;
+            }
+            return a / b;
+        case MOD:
+            if (b == 0 || b == -1 || b == 1) return 0;
+            result = a % b;
+            if (result != 0 && (result < 0) != (b < 0)) result += b;
+            return result;
+    }
+    return std::nullopt;
+}
+
+void ConstantFolder::foldUnit(ASTNode *declarations, ASTNode *commands) {
+    tracked.clear();
+    literals.clear();
+    collectLiterals(commands);
+    if (auto declarationsNode =
+            ASTNodeFactory::castNode<DeclarationsNode>(declarations)) {
+        tracked.insert(declarationsNode->pidentifiers.begin(),
+                       declarationsNode->pidentifiers.end());
+        for (auto &array : declarationsNode->arrays)
+            tracked.erase(array.pidentifier);
+    }
+    Values values;
+    foldCommands(commands, values);
+}
+
+void ConstantFolder::foldCommands(ASTNode *node, Values &values) {
+    auto commandsNode = ASTNodeFactory::castNode<CommandsNode>(node);
+    if (!commandsNode) return;
+    for (auto &command : commandsNode->commands) foldCommand(command, values);
+}
+
+void ConstantFolder::foldCommand(ASTNode *node, Values &values) {
+    switch (node->getNodeType()) {
+        case ASSIGNMENT_NODE: {
+            auto assignmentNode = ASTNodeFactory::castNode<AssignmentNode>(node);
+            auto result = foldExpression(assignmentNode->expression, values);
+            foldIndex(assignmentNode->identifier, values);
+            if (auto name = scalarName(assignmentNode->identifier)) {
+                if (result.has_value())
+                    values[*name] = *result;
+                else
+                    values.erase(*name);
+            }
+            break;
+        }
+        case IF_STATEMENT_NODE: {
+            auto ifNode = ASTNodeFactory::castNode<IfStatementNode>(node);
+            foldCondition(ifNode->condition, values);
+            Values thenValues = values;
+            foldCommands(ifNode->commands, thenValues);
+            if (ifNode->elseCommands.has_value())
+                foldCommands(ifNode->elseCommands.value(), values);
+            for (auto it = values.begin(); it != values.end();) {
+                auto other = thenValues.find(it->first);
+                if (other == thenValues.end() || other->second != it->second)
+                    it = values.erase(it);
+                else
+                    ++it;
+            }
+            break;
+        }
+        case WHILE_STATEMENT_NODE: {
+            auto whileNode = ASTNodeFactory::castNode<WhileStatementNode>(node);
+            foldLoop(whileNode->condition, whileNode->commands, values, true);
+            break;
+        }
+        case REPEAT_STATEMENT_NODE: {
+            auto repeatNode = ASTNodeFactory::castNode<RepeatStatementNode>(node);
+            foldLoop(repeatNode->condition, repeatNode->commands, values, false);
+            break;
+        }
+        case FOR_TO_NODE:
+        case FOR_DOWNTO_NODE: {
+            std::string iterator;
+            ASTNode *commands;
+            if (auto forToNode = ASTNodeFactory::castNode<ForToNode>(node)) {
+                foldValue(forToNode->valueFrom, values);
+                foldValue(forToNode->valueTo, values);
+                iterator = forToNode->pidentifier;
+                commands = forToNode->commands;
+            } else {
+                auto forDowntoNode =
+                    ASTNodeFactory::castNode<ForDowntoNode>(node);
+                foldValue(forDowntoNode->valueFrom, values);
+                foldValue(forDowntoNode->valueTo, values);
+                iterator = forDowntoNode->pidentifier;
+                commands = forDowntoNode->commands;
+            }
+            // the bounds are read once; the body sees the iterator, not a
+            // variable of the same name
+            std::set<std::string> assigned = {iterator};
+            assignedIn(commands, assigned);
+            for (auto &name : assigned) values.erase(name);
+            bool shadowed = tracked.erase(iterator) > 0;
+            Values body = values;
+            loopDepth++;
+            foldCommands(commands, body);
+            loopDepth--;
+            if (shadowed) tracked.insert(iterator);
+            break;
+        }
+        case PROC_CALL_NODE: {
+            auto procCallNode = ASTNodeFactory::castNode<ProcCallNode>(node);
+            auto argsNode = ASTNodeFactory::castNode<ArgsNode>(procCallNode->args);
+            if (argsNode) {
+                for (auto &arg : argsNode->pidentifiers) values.erase(arg);
+            }
+            break;
+        }
+        case READ_NODE: {
+            auto readNode = ASTNodeFactory::castNode<ReadNode>(node);
+            foldIndex(readNode->identifier, values);
+            if (auto name = scalarName(readNode->identifier)) values.erase(*name);
+            break;
+        }
+        case WRITE_NODE: {
+            auto writeNode = ASTNodeFactory::castNode<WriteNode>(node);
+            foldValue(writeNode->value, values);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unexpected command node!");
+    }
+}
+
+// Every pass through the body starts with what holds before the loop less
+// what the body assigns. WHILE leaves with what held at its condition,
+// REPEAT with what holds after its body.
+void ConstantFolder::foldLoop(ASTNode *condition, ASTNode *commands,
+                              Values &values, bool conditionFirst) {
+    std::set<std::string> assigned;
+    assignedIn(commands, assigned);
+    for (auto &name : assigned) values.erase(name);
+
+    loopDepth++;
+    if (conditionFirst) {
+        foldCondition(condition, values);
+        Values body = values;
+        foldCommands(commands, body);
+    } else {
+        foldCommands(commands, values);
+        foldCondition(condition, values);
+    }
+    loopDepth--;
+}
+
+void ConstantFolder::foldCondition(ASTNode *node, const Values &values) {
+    auto conditionNode = ASTNodeFactory::castNode<ConditionNode>(node);
+    foldValue(conditionNode->value1, values);
+    foldValue(conditionNode->value2, values);
+}
+
+// A literal costs a constant cell set up at the start unless the unit
+// already uses it, which is more than one addition or subtraction saves
+// when it runs once.
+bool ConstantFolder::worthFolding(MathOperation op, long long result) const {
+    return op == MULTIPLY || op == DIVIDE || op == MOD || loopDepth > 0 ||
+           literals.count(result);
+}
+
+std::optional<long long> ConstantFolder::foldExpression(ASTNode *node,
+                                                        const Values &values) {
+    auto expressionNode = ASTNodeFactory::castNode<ExpressionNode>(node);
+    auto a = foldValue(expressionNode->value1, values);
+    if (!expressionNode->value2.has_value()) return a;
+    auto b = foldValue(expressionNode->value2.value(), values);
+    auto op = expressionNode->mathOperation.value();
+    if (a.has_value() != b.has_value()) {
+        // multiplication and division by a literal need no loop
+        if (op == MULTIPLY && a.has_value())
+            toLiteral(expressionNode->value1, *a);
+        else if (b.has_value() && op != PLUS && op != SUBSTRACT)
+            toLiteral(expressionNode->value2.value(), *b);
+        return std::nullopt;
+    }
+    if (!a.has_value()) return std::nullopt;
+
+    auto result = evaluate(op, *a, *b);
+    if (!result.has_value() || !worthFolding(op, *result)) return result;
+    toLiteral(expressionNode->value1, *result);
+    expressionNode->value2.reset();
+    expressionNode->mathOperation.reset();
+    return result;
+}
+
+void ConstantFolder::toLiteral(ASTNode *node, long long value) {
+    auto valueNode = ASTNodeFactory::castNode<ValueNode>(node);
+    if (valueNode->num.has_value() && !valueNode->identifier.has_value() &&
+        literal(valueNode->num.value()) == value)
+        return;
+    valueNode->num = std::to_string(value);
+    valueNode->identifier.reset();
+    literals.insert(value);
+    folded++;
+}
+
+// Value of a literal or of a variable known to hold one. The read itself
+// stays: a literal costs as much to read as a variable.
+std::optional<long long> ConstantFolder::foldValue(ASTNode *node,
+                                                   const Values &values) {
+    auto valueNode = ASTNodeFactory::castNode<ValueNode>(node);
+    if (valueNode->num.has_value()) return literal(valueNode->num.value());
+    if (!valueNode->identifier.has_value()) return std::nullopt;
+
+    foldIndex(valueNode->identifier.value(), values);
+    auto name = scalarName(valueNode->identifier.value());
+    if (!name.has_value()) return std::nullopt;
+    auto known = values.find(*name);
+    if (known == values.end()) return std::nullopt;
+    return known->second;
+}
+
+void ConstantFolder::foldIndex(ASTNode *node, const Values &values) {
+    auto identifierNode = ASTNodeFactory::castNode<IdentifierNode>(node);
+    if (!identifierNode->arrayPidentifierIndex.has_value()) return;
+    auto &index = identifierNode->arrayPidentifierIndex.value();
+    if (!tracked.count(index)) return;
+    auto known = values.find(index);
+    if (known == values.end()) return;
+    identifierNode->arrayNumIndex = std::to_string(known->second);
+    identifierNode->arrayPidentifierIndex.reset();
+    literals.insert(known->second);
+    folded++;
+}
+
+std::optional<long long> ConstantFolder::literal(const std::string &text) {
+    try {
+        return std::stoll(text);
+    } catch (const std::out_of_range &) {
+        return std::nullopt;
+    }
+}
+
+void ConstantFolder::collectLiterals(ASTNode *node) {
+    if (!node) return;
+    auto add = [this](const std::optional<std::string> &text) {
+        if (!text.has_value()) return;
+        if (auto value = literal(text.value())) literals.insert(*value);
+    };
+    switch (node->getNodeType()) {
+        case COMMANDS_NODE:
+            for (auto &command :
+                 ASTNodeFactory::castNode<CommandsNode>(node)->commands)
+                collectLiterals(command);
+            break;
+        case ASSIGNMENT_NODE: {
+            auto assignmentNode = ASTNodeFactory::castNode<AssignmentNode>(node);
+            collectLiterals(assignmentNode->identifier);
+            collectLiterals(assignmentNode->expression);
+            break;
+        }
+        case IF_STATEMENT_NODE: {
+            auto ifNode = ASTNodeFactory::castNode<IfStatementNode>(node);
+            collectLiterals(ifNode->condition);
+            collectLiterals(ifNode->commands);
+            if (ifNode->elseCommands.has_value())
+                collectLiterals(ifNode->elseCommands.value());
+            break;
+        }
+        case WHILE_STATEMENT_NODE: {
+            auto whileNode = ASTNodeFactory::castNode<WhileStatementNode>(node);
+            collectLiterals(whileNode->condition);
+            collectLiterals(whileNode->commands);
+            break;
+        }
+        case REPEAT_STATEMENT_NODE: {
+            auto repeatNode = ASTNodeFactory::castNode<RepeatStatementNode>(node);
+            collectLiterals(repeatNode->condition);
+            collectLiterals(repeatNode->commands);
+            break;
+        }
+        case FOR_TO_NODE: {
+            auto forToNode = ASTNodeFactory::castNode<ForToNode>(node);
+            collectLiterals(forToNode->valueFrom);
+            collectLiterals(forToNode->valueTo);
+            collectLiterals(forToNode->commands);
+            break;
+        }
+        case FOR_DOWNTO_NODE: {
+            auto forDowntoNode = ASTNodeFactory::castNode<ForDowntoNode>(node);
+            collectLiterals(forDowntoNode->valueFrom);
+            collectLiterals(forDowntoNode->valueTo);
+            collectLiterals(forDowntoNode->commands);
+            break;
+        }
+        case READ_NODE:
+            collectLiterals(ASTNodeFactory::castNode<ReadNode>(node)->identifier);
+            break;
+        case WRITE_NODE:
+            collectLiterals(ASTNodeFactory::castNode<WriteNode>(node)->value);
+            break;
+        case EXPRESSION_NODE: {
+            auto expressionNode = ASTNodeFactory::castNode<ExpressionNode>(node);
+            collectLiterals(expressionNode->value1);
+            if (expressionNode->value2.has_value())
+                collectLiterals(expressionNode->value2.value());
+            break;
+        }
+        case CONDITION_NODE: {
+            auto conditionNode = ASTNodeFactory::castNode<ConditionNode>(node);
+            collectLiterals(conditionNode->value1);
+            collectLiterals(conditionNode->value2);
+            break;
+        }
+        case VALUE_NODE: {
+            auto valueNode = ASTNodeFactory::castNode<ValueNode>(node);
+            add(valueNode->num);
+            if (valueNode->identifier.has_value())
+                collectLiterals(valueNode->identifier.value());
+            break;
+        }
+        case IDENTIFIER_NODE:
+            add(ASTNodeFactory::castNode<IdentifierNode>(node)->arrayNumIndex);
+            break;
+        default:
+            break;
+    }
+}
+
+void ConstantFolder::assignedIn(ASTNode *node, std::set<std::string> &names) {
+    if (!node) return;
+    switch (node->getNodeType()) {
+        case COMMANDS_NODE:
+            for (auto &command :
+                 ASTNodeFactory::castNode<CommandsNode>(node)->commands)
+                assignedIn(command, names);
+            break;
+        case ASSIGNMENT_NODE: {
+            auto assignmentNode = ASTNodeFactory::castNode<AssignmentNode>(node);
+            if (auto name = scalarName(assignmentNode->identifier))
+                names.insert(*name);
+            break;
+        }
+        case READ_NODE: {
+            auto readNode = ASTNodeFactory::castNode<ReadNode>(node);
+            if (auto name = scalarName(readNode->identifier)) names.insert(*name);
+            break;
+        }
+        case PROC_CALL_NODE: {
+            auto procCallNode = ASTNodeFactory::castNode<ProcCallNode>(node);
+            if (auto argsNode =
+                    ASTNodeFactory::castNode<ArgsNode>(procCallNode->args))
+                names.insert(argsNode->pidentifiers.begin(),
+                             argsNode->pidentifiers.end());
+            break;
+        }
+        case IF_STATEMENT_NODE: {
+            auto ifNode = ASTNodeFactory::castNode<IfStatementNode>(node);
+            assignedIn(ifNode->commands, names);
+            if (ifNode->elseCommands.has_value())
+                assignedIn(ifNode->elseCommands.value(), names);
+            break;
+        }
+        case WHILE_STATEMENT_NODE:
+            assignedIn(
+                ASTNodeFactory::castNode<WhileStatementNode>(node)->commands,
+                names);
+            break;
+        case REPEAT_STATEMENT_NODE:
+            assignedIn(
+                ASTNodeFactory::castNode<RepeatStatementNode>(node)->commands,
+                names);
+            break;
+        case FOR_TO_NODE:
+            assignedIn(ASTNodeFactory::castNode<ForToNode>(node)->commands,
+                       names);
+            break;
+        case FOR_DOWNTO_NODE:
+            assignedIn(ASTNodeFactory::castNode<ForDowntoNode>(node)->commands,
+                       names);
+            break;
+        default:
+            break;
+    }
+}
+
+std::optional<std::string> ConstantFolder::scalarName(ASTNode *identifier) const {
+    auto identifierNode = ASTNodeFactory::castNode<IdentifierNode>(identifier);
+    if (!identifierNode || !identifierNode->pidentifier.has_value())
+        return std::nullopt;
+    auto &name = identifierNode->pidentifier.value();
+    if (!tracked.count(name)) return std::nullopt;
+    return name;
+}
+
+}  // namespace ast
@@ -3,31 +3,45 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 
 #include "ASTNode.hpp"
 #include "ASTNodeFactory.hpp"
+#include "BinaryFormat.hpp"
 #include "Command.hpp"
 #include "Context.hpp"
 #include "ErrorMessages.hpp"
 #include "InstructNodes.hpp"
 #include "Instructions.hpp"
 #include "Memory.hpp"
+#include "Peephole.hpp"
 #include "ProceduresNode.hpp"
 #include "SymbolTable.hpp"
 
 namespace codegen {
 
+// Value of a number in the source, if it fits in 64 bits.
+static std::optional<long long> literalOf(ASTNode *node) {
+    auto valueNode = ast::ASTNodeFactory::castNode<ast::ValueNode>(node);
+    if (!valueNode || !valueNode->num.has_value()) return std::nullopt;
+    try {
+        return std::stoll(valueNode->num.value());
+    } catch (const std::out_of_range &) {
+        return std::nullopt;
+    }
+}
+
 CodeGenerator::CodeGenerator(compiler::Context &context)
     : currentProcName(""),
       currentCommand(UNDEFINED),
       lineCounter(0),
       exitCode(semana::SUCCESS),
-      noConditions(0),
-      noRepeats(0),
-      noWhiles(0),
-      noFors(0),
+      mainLabel(0),
+      jumpToMainLine(0),
       accAddr(0),
       context(context),
       memory(context.symbolTable.getLastUsedAddr()),
@@ -35,20 +49,61 @@ CodeGenerator::CodeGenerator(compiler::Context &context)
       conditionNode(memory),
       repeatNode(memory),
       whileNode(memory),
-      forNode(memory) {}
+      forNode(memory),
+      runtime(context.inlineLimit) {}
 
 CodeGenerator::~CodeGenerator() {}
 
 semana::ExitCode CodeGenerator::generateCode() {
+    planRuntimeCalls();
+    beginSource(0, "constants");
     setRValues();
+    setSourceKind("entry");
     jumpToMain();
+    endSource();
     processNode(context.astRoot);
+    optimize();
+    saveInstructionsToFile();
+    if (!context.mapFile.empty()) saveSourceMap();
+    return exitCode;
+}
+
+// Code generated elsewhere (lowered from the IR) goes to the same output
+// file and source map.
+semana::ExitCode CodeGenerator::saveCode(std::vector<Instruction> code,
+                                         std::vector<SourceOrigin> origins) {
+    instructions = std::move(code);
+    sourceMap = std::move(origins);
+    optimize();
     saveInstructionsToFile();
+    if (!context.mapFile.empty()) saveSourceMap();
     return exitCode;
 }
 
+// Labels are resolved first: the peephole pass follows jumps by target.
+void CodeGenerator::optimize() {
+    for (auto &i : instructions) {
+        if (i.mode != LABEL) continue;
+        i.value = resolveLabel(i.target());
+        i.mode = VALUE;
+        i.offset = 0;
+    }
+    sourceMap.resize(instructions.size(), SourceOrigin{0, "other"});
+
+    std::vector<unsigned long> constantCells;
+    for (auto &rvalue : context.symbolTable.getRValues())
+        constantCells.push_back(rvalue.address);
+    PeepholeOptimizer peephole(context.peepholeRules,
+                               context.symbolTable.getLastUsedAddr(),
+                               constantCells);
+    peephole.run(instructions, sourceMap);
+    if (context.peepholeReport) peephole.printReport(std::cout);
+}
+
 void CodeGenerator::processNode(ASTNode *node) {
     if (!node) throw std::runtime_error("Empty node!");
+    bool statement = beginSource(node);
+    if (statement) statementTemps.emplace_back();
 
     switch (node->getNodeType()) {
         case PROGRAM_ALL_NODE: {
@@ -59,6 +114,7 @@ void CodeGenerator::processNode(ASTNode *node) {
             }
             processNode(programAllNode->main);
             addHalt();
+            addRuntimeLibrary();
             break;
         }
         case PROCEDURES_NODE: {
@@ -76,19 +132,15 @@ void CodeGenerator::processNode(ASTNode *node) {
                     proceduresNode->proc_head);
             auto procName = procHeadNode->pidentifier;
             auto returnReg = context.symbolTable.getProcedureAddr(procName);
+            setSourceKind("return");
             instructions.emplace_back(RTRN, returnReg);
             lineCounter++;
             break;
         }
         case MAIN_NODE: {
             auto mainNode = ast::ASTNodeFactory::castNode<ast::MainNode>(node);
-            std::string mainName = "main";
-            auto it = std::find_if(markers.begin(), markers.end(),
-                                   [&mainName](const Marker &marker) {
-                                       return marker.name == mainName;
-                                   });
-            it->line += lineCounter;
-            currentProcName = mainName;
+            setLabel(mainLabel, lineCounter - jumpToMainLine);
+            currentProcName = "main";
             processNode(mainNode->declarations);
             processNode(mainNode->commands);
             break;
@@ -105,6 +157,25 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto assignmentNode =
                 ast::ASTNodeFactory::castNode<ast::AssignmentNode>(node);
             currentCommand = ASSIGN;
+            callRuntime = runtimeCalls.count(node) > 0;
+            auto expression =
+                ast::ASTNodeFactory::castNode<ast::ExpressionNode>(
+                    assignmentNode->expression);
+            if (expression->value2.has_value()) {
+                switch (expression->mathOperation.value()) {
+                    case ast::MULTIPLY:
+                        setSourceKind("multiply");
+                        break;
+                    case ast::DIVIDE:
+                        setSourceKind("divide");
+                        break;
+                    case ast::MOD:
+                        setSourceKind("modulo");
+                        break;
+                    default:
+                        break;
+                }
+            }
             processNode(assignmentNode->identifier);
             processNode(assignmentNode->expression);
             break;
@@ -113,30 +184,28 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto ifStatementNode =
                 ast::ASTNodeFactory::castNode<ast::IfStatementNode>(node);
             // label condition
-            noConditions++;
             currentCommand = CONDITION;
-            std::string label = "condition" + std::to_string(noConditions);
-            this->conditionNode.name = label;
+            LabelId label = newLabel();
+            this->conditionNode.label = label;
             processNode(ifStatementNode->condition);
             auto currLineCounter1 = lineCounter;
             processNode(ifStatementNode->commands);
             auto currLineCounter2 = lineCounter;
             auto relativePathDist = currLineCounter2 - currLineCounter1 + 1;
             if (ifStatementNode->elseCommands.has_value()) relativePathDist++;
-            markers.emplace_back(label, relativePathDist);
-            // find jump to label in instruction and change it to relative path
+            setLabel(label, relativePathDist);
             if (ifStatementNode->elseCommands.has_value()) {
-                std::string label =
-                    "condition_else" + std::to_string(noConditions);
-                this->conditionNode.name = label;
+                LabelId label = newLabel();
+                this->conditionNode.label = label;
                 this->conditionNode.elseExist = true;
-                instructions.emplace_back(JUMP, label);
+                setSourceKind("else_jump");
+                instructions.emplace_back(JUMP, Label{label});
                 lineCounter++;
                 auto currLineCounter1 = lineCounter;
                 processNode(ifStatementNode->elseCommands.value());
                 auto currLineCounter2 = lineCounter;
                 auto relativePathDist = currLineCounter2 - currLineCounter1 + 1;
-                markers.emplace_back(label, relativePathDist);
+                setLabel(label, relativePathDist);
             }
             break;
         }
@@ -144,10 +213,9 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto whileStatementNode =
                 ast::ASTNodeFactory::castNode<ast::WhileStatementNode>(node);
             currentCommand = WHILE;
-            noWhiles++;
-            std::string label1 = "while_cond" + std::to_string(noWhiles);
-            std::string label2 = "while_beg" + std::to_string(noWhiles);
-            this->whileNode.name = label1;
+            LabelId label1 = newLabel();
+            LabelId label2 = newLabel();
+            this->whileNode.label = label1;
             auto currLineCounter1 = lineCounter;
             processNode(whileStatementNode->condition);
             auto currLineCounter2 = lineCounter;
@@ -155,9 +223,10 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto currLineCounter3 = lineCounter;
             auto relativePathDist1 = currLineCounter3 - currLineCounter2 + 2;
             auto relativePathDist2 = currLineCounter1 - currLineCounter3;
-            markers.emplace_back(label1, relativePathDist1);
-            markers.emplace_back(label2, relativePathDist2);
-            instructions.emplace_back(JUMP, label2);
+            setLabel(label1, relativePathDist1);
+            setLabel(label2, relativePathDist2);
+            setSourceKind("while_jump");
+            instructions.emplace_back(JUMP, Label{label2});
             lineCounter++;
             break;
         }
@@ -165,15 +234,14 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto repeatStatementNode =
                 ast::ASTNodeFactory::castNode<ast::RepeatStatementNode>(node);
             auto currLineCounter1 = lineCounter;
-            noRepeats++;
-            std::string label = "repeat" + std::to_string(noRepeats);
+            LabelId label = newLabel();
             processNode(repeatStatementNode->commands);
             currentCommand = REPEAT;
-            this->repeatNode.name = label;
+            this->repeatNode.label = label;
             processNode(repeatStatementNode->condition);
             auto currLineCounter2 = lineCounter;
             auto relativePathDist = currLineCounter1 - currLineCounter2 + 1;
-            markers.emplace_back(label, relativePathDist);
+            setLabel(label, relativePathDist);
             break;
         }
         case FOR_TO_NODE: {
@@ -184,30 +252,29 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto symbol =
                 context.symbolTable.getSymbolByName(pidentifier, currentScope);
             auto symbolAddress = symbol.address;
-            noFors++;
             currentCommand = FOR_TO;
             this->forNode.iterator = symbolAddress;
             this->forNode.mode = UP_STEP;
             auto currLineCounter1 = lineCounter;
-            std::string label1 = "beg_for_to" + std::to_string(noFors);
-            std::string label2 = "end_for_to" + std::to_string(noFors);
-            this->forNode.name = label2;
+            LabelId label1 = newLabel();
+            LabelId label2 = newLabel();
+            this->forNode.label = label2;
             processNode(forToNode->valueFrom);
             processNode(forToNode->valueTo);
             processNode(forToNode->commands);
             // increment iterator
-            instructions.emplace_back(
-                SET, 1);  // TODO: change it to reusing "1" rvalue instead of
-                          // setting it in each iteration
+            setSourceKind("for_step");
+            // the for-step peephole rule turns this into LOAD i; ADD one
+            instructions.emplace_back(SET, 1);
             instructions.emplace_back(ADD, symbolAddress);
             instructions.emplace_back(STORE, symbolAddress);
-            instructions.emplace_back(JUMP, label1);
+            instructions.emplace_back(JUMP, Label{label1});
             lineCounter += 4;
             auto currLineCounter2 = lineCounter;
             auto relativePathDist1 = currLineCounter1 - currLineCounter2 + 3;
             auto relativePathDist2 = currLineCounter2 - currLineCounter1 - 4;
-            markers.emplace_back(label1, relativePathDist1);
-            markers.emplace_back(label2, relativePathDist2);
+            setLabel(label1, relativePathDist1);
+            setLabel(label2, relativePathDist2);
             break;
         }
         case FOR_DOWNTO_NODE: {
@@ -218,34 +285,32 @@ void CodeGenerator::processNode(ASTNode *node) {
             auto symbol =
                 context.symbolTable.getSymbolByName(pidentifier, currentScope);
             auto symbolAddress = symbol.address;
-            noFors++;
             currentCommand = FOR_DOWNTO;
             this->forNode.iterator = symbolAddress;
             this->forNode.mode = DOWN_STEP;
-            std::string label1 = "beg_for_down_to" + std::to_string(noFors);
-            std::string label2 = "end_for_down_to" + std::to_string(noFors);
-            this->forNode.name = label2;
+            LabelId label1 = newLabel();
+            LabelId label2 = newLabel();
+            this->forNode.label = label2;
             processNode(forDowntoNode->valueFrom);
             processNode(forDowntoNode->valueTo);
             auto currLineCounter1 = lineCounter;
             processNode(forDowntoNode->commands);
             // increment iterator
-            instructions.emplace_back(
-                SET, 1);  // TODO: change it to reusing "1" rvalue instead of
-                          // setting it in each iteration
-            auto freeReg = memory.getFreeRegister();
-            memory.lockReg(freeReg);
+            setSourceKind("for_step");
+            // the for-step-down peephole rule turns this into LOAD i; SUB one
+            instructions.emplace_back(SET, 1);
+            TempCell freeReg(memory);
             instructions.emplace_back(STORE, freeReg);
             instructions.emplace_back(LOAD, symbolAddress);
             instructions.emplace_back(SUB, freeReg);
             instructions.emplace_back(STORE, symbolAddress);
-            instructions.emplace_back(JUMP, label1);
+            instructions.emplace_back(JUMP, Label{label1});
             lineCounter += 6;
             auto currLineCounter2 = lineCounter;
             auto relativePathDist1 = currLineCounter1 - currLineCounter2 - 2;
             auto relativePathDist2 = currLineCounter2 - currLineCounter1 + 1;
-            markers.emplace_back(label1, relativePathDist1);
-            markers.emplace_back(label2, relativePathDist2);
+            setLabel(label1, relativePathDist1);
+            setLabel(label2, relativePathDist2);
             break;
         }
         case PROC_CALL_NODE: {
@@ -257,17 +322,13 @@ void CodeGenerator::processNode(ASTNode *node) {
 
             // prepare return register
             auto procAddr = context.symbolTable.getProcedureAddr(procName);
-            instructions.emplace_back(SET, lineCounter + 3);
+            instructions.push_back(Instruction::line(SET, lineCounter + 3));
             instructions.emplace_back(STORE, procAddr);
             lineCounter += 2;
 
             // jump to procedure
             auto currLine = lineCounter;
-            auto it = std::find_if(markers.begin(), markers.end(),
-                                   [&procName](const Marker &marker) {
-                                       return marker.name == procName;
-                                   });
-            auto jump = it->line - currLine;
+            auto jump = procedures.at(procName) - currLine;
             instructions.emplace_back(JUMP, jump);
             lineCounter++;
             break;
@@ -290,7 +351,7 @@ void CodeGenerator::processNode(ASTNode *node) {
                 ast::ASTNodeFactory::castNode<ast::ProcHeadNode>(node);
             auto procedureName = procHeadNode->pidentifier;
             currentProcName = procedureName;
-            markers.emplace_back(procedureName, lineCounter);
+            procedures[procedureName] = lineCounter;
             processNode(procHeadNode->args_decl);
             break;
         }
@@ -302,6 +363,14 @@ void CodeGenerator::processNode(ASTNode *node) {
         case ARGS_DECL_NODE: {
             auto argsDeclNode =
                 ast::ASTNodeFactory::castNode<ast::ArgsDeclNode>(node);
+
+            // scalar arguments hold the address of the variable passed
+            auto currentScope = getCurrentScope();
+            for (auto &arg : argsDeclNode->pidentifiers) {
+                markPointer(
+                    context.symbolTable.getSymbolByName(arg, currentScope)
+                        .address);
+            }
             break;
         }
         case ARGS_NODE: {
@@ -321,7 +390,7 @@ void CodeGenerator::processNode(ASTNode *node) {
                 auto ptrAddr = context.symbolTable.getAddrOfProcArg(
                     currProcCallName, noArgs);
 
-                heap.push_back(ptrAddr);
+                markPointer(ptrAddr);
 
                 // if we call from another function (not main) then LOAD adres
                 // instead of setting bc argAddr will be already ptr type
@@ -347,6 +416,9 @@ void CodeGenerator::processNode(ASTNode *node) {
                     expressionNode->mathOperation
                         .value());  // be careful here - enums may be not
                                     // mapped in exactly same way
+                assignNode.constant2 = literalOf(expressionNode->value1);
+                assignNode.constant3 =
+                    literalOf(expressionNode->value2.value());
             }
             processNode(expressionNode->value1);
             if (expressionNode->value2.has_value()) {
@@ -397,8 +469,6 @@ void CodeGenerator::processNode(ASTNode *node) {
                 auto symbol = context.symbolTable.getSymbolByName(pidentifier,
                                                                   currentScope);
                 auto symbolAddress = symbol.address;
-                if (isProcArgument(pidentifier, currentScope))
-                    heap.push_back(symbolAddress);
                 addCommand(pidentifier, symbolAddress);
             }
             if (identifierNode->Tpidentifier.has_value()) {
@@ -412,9 +482,7 @@ void CodeGenerator::processNode(ASTNode *node) {
                             .getSymbolByName(pidentifier, currentScope)
                             .address;
 
-                    auto newPointer = memory.getFreeRegister();
-                    memory.lockReg(newPointer);  // needs to be unlocked
-                    heap.push_back(newPointer);
+                    auto newPointer = leasePointer();
 
                     if (identifierNode->arrayNumIndex.has_value()) {
                         auto pidentifier2 =
@@ -423,7 +491,8 @@ void CodeGenerator::processNode(ASTNode *node) {
                             pidentifier2, currentScope);
                         auto symbolAddress2 = symbol2.address;
                         instructions.emplace_back(LOAD, pointer, true);
-                        instructions.emplace_back(ADD, symbolAddress2);
+                        instructions.emplace_back(
+                            accessThrough(ADD, symbolAddress2), symbolAddress2);
                         instructions.emplace_back(STORE, newPointer, true);
 
                         lineCounter += 3;
@@ -436,16 +505,14 @@ void CodeGenerator::processNode(ASTNode *node) {
                             pidentifier2, currentScope);
                         auto symbolAddress2 = symbol2.address;
                         instructions.emplace_back(LOAD, pointer, true);
-                        instructions.emplace_back(ADD, symbolAddress2);
+                        instructions.emplace_back(
+                            accessThrough(ADD, symbolAddress2), symbolAddress2);
                         instructions.emplace_back(STORE, newPointer, true);
                         lineCounter += 3;
                         addCommand(pidentifier, newPointer);
                     }
                 } else {
-                    auto pointer = memory.getFreeRegister();
-                    memory.lockReg(pointer);  // needs to be unlocked
-                    heap.push_back(pointer);
-                    arrayPointers[symbolAddress] = pointer;
+                    auto pointer = leasePointer();
 
                     if (identifierNode->arrayNumIndex.has_value()) {
                         auto pidentifier2 =
@@ -455,7 +522,9 @@ void CodeGenerator::processNode(ASTNode *node) {
                         auto symbolAddress2 = symbol2.address;
                         instructions.emplace_back(SET, symbolAddress);
                         instructions.emplace_back(STORE, pointer, true);
-                        instructions.emplace_back(LOAD, symbolAddress2);
+                        instructions.emplace_back(
+                            accessThrough(LOAD, symbolAddress2),
+                            symbolAddress2);
                         instructions.emplace_back(ADD, pointer, true);
                         instructions.emplace_back(STORE, pointer, true);
                         lineCounter += 5;
@@ -469,7 +538,9 @@ void CodeGenerator::processNode(ASTNode *node) {
                         auto symbolAddress2 = symbol2.address;
                         instructions.emplace_back(SET, symbolAddress);
                         instructions.emplace_back(STORE, pointer, true);
-                        instructions.emplace_back(LOAD, symbolAddress2);
+                        instructions.emplace_back(
+                            accessThrough(LOAD, symbolAddress2),
+                            symbolAddress2);
                         instructions.emplace_back(ADD, pointer, true);
                         instructions.emplace_back(STORE, pointer, true);
                         lineCounter += 5;
@@ -482,6 +553,77 @@ void CodeGenerator::processNode(ASTNode *node) {
         default:
             throw std::runtime_error("Unknown node type");
     }
+    if (statement) {
+        releaseStatementTemps();
+        endSource();
+    }
+}
+
+// Statements open a source scope: instructions emitted until the scope is
+// closed (and not claimed by a nested statement) are mapped to its line.
+bool CodeGenerator::beginSource(ASTNode *node) {
+    const char *kind = nullptr;
+    switch (node->getNodeType()) {
+        case PROGRAM_ALL_NODE:
+            kind = "halt";
+            break;
+        case PROCEDURES_NODE:
+            kind = "procedure";
+            break;
+        case MAIN_NODE:
+            kind = "main";
+            break;
+        case ASSIGNMENT_NODE:
+            kind = "assign";
+            break;
+        case IF_STATEMENT_NODE:
+            kind = "if_condition";
+            break;
+        case WHILE_STATEMENT_NODE:
+            kind = "while_condition";
+            break;
+        case REPEAT_STATEMENT_NODE:
+            kind = "repeat_condition";
+            break;
+        case FOR_TO_NODE:
+        case FOR_DOWNTO_NODE:
+            kind = "for_header";
+            break;
+        case PROC_CALL_NODE:
+            kind = "call";
+            break;
+        case READ_NODE:
+            kind = "read";
+            break;
+        case WRITE_NODE:
+            kind = "write";
+            break;
+        default:
+            return false;
+    }
+    beginSource(node->getPosition().line, kind);
+    return true;
+}
+
+void CodeGenerator::beginSource(int line, const char *kind) {
+    syncSourceMap();
+    sourceStack.push_back({line, kind});
+}
+
+void CodeGenerator::endSource() {
+    syncSourceMap();
+    sourceStack.pop_back();
+}
+
+void CodeGenerator::setSourceKind(const char *kind) {
+    syncSourceMap();
+    sourceStack.back().kind = kind;
+}
+
+void CodeGenerator::syncSourceMap() {
+    SourceOrigin origin =
+        sourceStack.empty() ? SourceOrigin{0, "other"} : sourceStack.back();
+    sourceMap.resize(instructions.size(), origin);
 }
 
 int CodeGenerator::getCurrentScope() {
@@ -495,8 +637,7 @@ void CodeGenerator::addHalt() {
 }
 
 void CodeGenerator::addWrite(unsigned long &address) {
-    auto it = std::find(heap.begin(), heap.end(), address);
-    if (it != heap.end()) {
+    if (isPointer(address)) {
         instructions.emplace_back(LOADI, address);
         instructions.emplace_back(PUT, 0);
         lineCounter += 2;
@@ -507,8 +648,7 @@ void CodeGenerator::addWrite(unsigned long &address) {
 }
 
 void CodeGenerator::addRead(unsigned long &address) {
-    auto it = std::find(heap.begin(), heap.end(), address);
-    if (it != heap.end()) {
+    if (isPointer(address)) {
         instructions.emplace_back(GET, 0);
         instructions.emplace_back(STOREI, address);
         lineCounter += 2;
@@ -519,11 +659,149 @@ void CodeGenerator::addRead(unsigned long &address) {
 }
 
 void CodeGenerator::addAssign(std::vector<Instruction> &instructions) {
+    for (auto &i : instructions) {
+        if (i.mode == VALUE && !i.doNotModify)
+            i.opcode = accessThrough(i.opcode, i.value);
+    }
     this->instructions.insert(this->instructions.end(), instructions.begin(),
                               instructions.end());
     lineCounter += instructions.size();
 }
 
+// Multiplications, divisions and remainders left to the loop kernels (no
+// literal factor or divisor) with the loops around them. A procedure adds
+// the deepest loop it is called from, known once its callers are visited.
+static void findArithmetic(
+    ASTNode *node, int depth,
+    std::vector<std::pair<ASTNode *, ArithmeticSite>> &sites,
+    std::map<std::string, int> &callDepth) {
+    switch (node->getNodeType()) {
+        case COMMANDS_NODE: {
+            auto commandsNode =
+                ast::ASTNodeFactory::castNode<ast::CommandsNode>(node);
+            for (auto &cmd : commandsNode->commands)
+                findArithmetic(cmd, depth, sites, callDepth);
+            break;
+        }
+        case ASSIGNMENT_NODE: {
+            auto assignmentNode =
+                ast::ASTNodeFactory::castNode<ast::AssignmentNode>(node);
+            auto expression =
+                ast::ASTNodeFactory::castNode<ast::ExpressionNode>(
+                    assignmentNode->expression);
+            if (!expression->value2.has_value()) break;
+            auto operation = static_cast<AssignOperation>(
+                expression->mathOperation.value());
+            bool literalDivisor =
+                literalOf(expression->value2.value()).has_value();
+            if (operation == MULTIPLY &&
+                !literalOf(expression->value1).has_value() && !literalDivisor)
+                sites.push_back({node, {operation, depth}});
+            if ((operation == DIVIDE || operation == MOD) && !literalDivisor)
+                sites.push_back({node, {operation, depth}});
+            break;
+        }
+        case IF_STATEMENT_NODE: {
+            auto ifStatementNode =
+                ast::ASTNodeFactory::castNode<ast::IfStatementNode>(node);
+            findArithmetic(ifStatementNode->commands, depth, sites, callDepth);
+            if (ifStatementNode->elseCommands.has_value())
+                findArithmetic(ifStatementNode->elseCommands.value(), depth,
+                               sites, callDepth);
+            break;
+        }
+        case WHILE_STATEMENT_NODE:
+            findArithmetic(
+                ast::ASTNodeFactory::castNode<ast::WhileStatementNode>(node)
+                    ->commands,
+                depth + 1, sites, callDepth);
+            break;
+        case REPEAT_STATEMENT_NODE:
+            findArithmetic(
+                ast::ASTNodeFactory::castNode<ast::RepeatStatementNode>(node)
+                    ->commands,
+                depth + 1, sites, callDepth);
+            break;
+        case FOR_TO_NODE:
+            findArithmetic(
+                ast::ASTNodeFactory::castNode<ast::ForToNode>(node)->commands,
+                depth + 1, sites, callDepth);
+            break;
+        case FOR_DOWNTO_NODE:
+            findArithmetic(
+                ast::ASTNodeFactory::castNode<ast::ForDowntoNode>(node)
+                    ->commands,
+                depth + 1, sites, callDepth);
+            break;
+        case PROC_CALL_NODE: {
+            auto &name =
+                ast::ASTNodeFactory::castNode<ast::ProcCallNode>(node)
+                    ->pidentifier;
+            callDepth[name] = std::max(callDepth[name], depth);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Procedures only call those declared before them, so main and then the
+// procedures backwards see every caller before its callees. The routines
+// get the cells right above the variables, the temporaries start above
+// them.
+void CodeGenerator::planRuntimeCalls() {
+    auto root = context.astRoot;
+    std::vector<std::pair<ASTNode *, ArithmeticSite>> found;
+    std::map<std::string, int> callDepth;
+    findArithmetic(
+        ast::ASTNodeFactory::castNode<ast::MainNode>(root->main)->commands, 0,
+        found, callDepth);
+    for (auto proc = root->procedures.rbegin(); proc != root->procedures.rend();
+         ++proc) {
+        auto proceduresNode =
+            ast::ASTNodeFactory::castNode<ast::ProceduresNode>(*proc);
+        auto procHeadNode = ast::ASTNodeFactory::castNode<ast::ProcHeadNode>(
+            proceduresNode->proc_head);
+        findArithmetic(proceduresNode->commands,
+                       callDepth[procHeadNode->pidentifier], found, callDepth);
+    }
+
+    std::vector<ArithmeticSite> sites;
+    for (auto &site : found) sites.push_back(site.second);
+    Memory routineMemory(context.symbolTable.getLastUsedAddr());
+    auto calls = runtime.plan(sites, routineMemory);
+    for (size_t k = 0; k < found.size(); k++) {
+        if (calls[k]) runtimeCalls.insert(found[k].first);
+    }
+    memory = Memory(routineMemory.lastUsedAddress());
+}
+
+// The assignment in the node as a call of the shared routine; its jump is
+// resolved once the routines are placed after the program.
+void CodeGenerator::addRuntimeCall() {
+    auto call = runtime.call(assignNode.operation, assignNode.identifier1,
+                             assignNode.identifier2,
+                             assignNode.identifier3.value(), lineCounter);
+    LabelId label = newLabel();
+    long jumpLine = lineCounter + call.size() - 2;
+    call[call.size() - 2] = Instruction(JUMP, Label{label});
+    runtimeJumps.push_back({label, jumpLine, assignNode.operation});
+    addAssign(call);
+    assignNode.codeGenerated = true;
+    assignNode.clear();
+}
+
+void CodeGenerator::addRuntimeLibrary() {
+    auto routines = runtime.place(lineCounter);
+    if (routines.empty()) return;
+    beginSource(0, "runtime");
+    for (auto &jump : runtimeJumps)
+        setLabel(jump.label, runtime.start(jump.operation) - jump.line);
+    instructions.insert(instructions.end(), routines.begin(), routines.end());
+    lineCounter += routines.size();
+    endSource();
+}
+
 void CodeGenerator::addJumpIfAccIsTrue(int &jump) {
     instructions.emplace_back(LOAD, accAddr);  // is this neccessary?
     instructions.emplace_back(JPOS, jump);
@@ -555,7 +833,10 @@ void CodeGenerator::addCommand(std::string &symbolName,
         }
         case ASSIGN: {
             NodeReadyToGenerateCode res = assignNode.addVariable(address);
-            if (res) {
+            if (res && callRuntime) {
+                addRuntimeCall();
+                currentCommand = UNDEFINED;
+            } else if (res) {
                 auto instructions = assignNode.generateCode();
                 addAssign(instructions);
                 assignNode.clear();
@@ -623,60 +904,145 @@ void CodeGenerator::setRValues() {
     auto rvalues = context.symbolTable.getRValues();
 
     for (auto &i : rvalues) {
-        instructions.emplace_back(SET, i.name, RVALUE);
+        instructions.push_back(Instruction::rvalue(SET, internRValue(i.name)));
         instructions.emplace_back(STORE, i.address);
         lineCounter += 2;
     }
 }
 
-long CodeGenerator::getMarkerForName(std::string &name) {
-    bool shouldBeIncremented = false;
-    bool shouldBeDecremented = false;
-    if (name.find(":inc") != std::string::npos) {
-        shouldBeIncremented = true;
-        name = name.substr(0, name.size() - 4);
-    }
-    if (name.find(":dec") != std::string::npos) {
-        shouldBeDecremented = true;
-        name = name.substr(0, name.size() - 4);
-    }
+// Literals keep their source text, which is what the text output prints.
+RValueId CodeGenerator::internRValue(const std::string &text) {
+    auto [it, inserted] = rvalueIds.emplace(text, rvalueTexts.size());
+    if (inserted) rvalueTexts.push_back(text);
+    return it->second;
+}
 
-    for (auto &i : markers) {
-        if (i.name == name) {
-            auto jump = i.line;
-            if (shouldBeIncremented) jump++;
-            if (shouldBeDecremented) jump--;
-            return jump;
-        }
-    }
+// Labels are allocated before the code they jump over is generated and get
+// their distance once it is known.
+LabelId CodeGenerator::newLabel() {
+    labels.emplace_back();
+    return labels.size() - 1;
+}
+
+void CodeGenerator::setLabel(LabelId label, long distance) {
+    labels[label] = distance;
+}
 
-    throw std::runtime_error("Did not find marker with name: " + name);
+long CodeGenerator::resolveLabel(const Label &label) {
+    auto &distance = labels.at(label.id);
+    if (!distance.has_value())
+        throw std::runtime_error("Unresolved label: " +
+                                 std::to_string(label.id));
+    return distance.value() + label.offset;
 }
 
 void CodeGenerator::saveInstructionsToFile() {
-    std::ofstream outFile(context.outputFile);
+    bool binary = mrb::isBinaryOutput(context.outputFile);
+    std::ofstream outFile(context.outputFile,
+                          binary ? std::ios::binary : std::ios::out);
     if (!outFile.is_open()) {
         throw std::runtime_error("Unable to open " + context.outputFile +
                                  " for writing.");
     }
 
+    // whole program is built in memory and written at once
+    std::ostringstream text;
+    std::vector<mrb::Record> records;
+    if (binary) records.reserve(instructions.size());
+
     for (auto &i : instructions) {
-        if (i.opcode == HALF || i.opcode == HALT)
-            outFile << i.opcode << std::endl;
-        else if (i.mode == LABEL) {
-            auto jumpOverIf = getMarkerForName(i.label);
-            outFile << i.opcode << " " << jumpOverIf << std::endl;
+        long long operand = 0;
+        if (i.opcode == HALF || i.opcode == HALT) {
+            if (!binary) text << i.opcode << '\n';
+        } else if (i.mode == LABEL) {
+            operand = resolveLabel(i.target());
+            if (!binary) text << i.opcode << " " << operand << '\n';
         } else if (i.mode == RVALUE) {
-            outFile << i.opcode << " " << i.label << std::endl;
+            if (binary)
+                operand = std::stoll(rvalueTexts[i.value]);
+            else
+                text << i.opcode << " " << rvalueTexts[i.value] << '\n';
         } else {
-            auto it = std::find(heap.begin(), heap.end(), i.value);
-            if (it != heap.end() && !i.doNotModify) updateOpcode(i.opcode);
-            outFile << i.opcode << " " << i.value << std::endl;
+            operand = i.value;
+            if (!binary) text << i.opcode << " " << operand << '\n';
         }
+        if (binary)
+            records.push_back({static_cast<uint32_t>(i.opcode), 0, operand});
+    }
+
+    if (binary) {
+        mrb::Header header = {{}, mrb::VERSION, records.size()};
+        std::copy(std::begin(mrb::MAGIC), std::end(mrb::MAGIC), header.magic);
+        outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        outFile.write(reinterpret_cast<const char *>(records.data()),
+                      records.size() * sizeof(mrb::Record));
+    } else {
+        const std::string &program = text.str();
+        outFile.write(program.data(), program.size());
     }
     outFile.close();
 }
 
+// Sidecar map: source line and kind of every instruction, then a static
+// per-line summary (instruction count, sum of base execution times).
+void CodeGenerator::saveSourceMap() {
+    std::ofstream mapFile(context.mapFile);
+    if (!mapFile.is_open()) {
+        throw std::runtime_error("Unable to open " + context.mapFile +
+                                 " for writing.");
+    }
+
+    std::ostringstream out;
+    std::map<int, std::pair<long, long>> lines;  // line -> count, cost
+    out << "instruction,line,kind,opcode\n";
+    for (size_t k = 0; k < instructions.size(); k++) {
+        const SourceOrigin &origin = sourceMap[k];
+        Opcode opcode = instructions[k].opcode;
+        out << k << ',' << origin.line << ',' << origin.kind << ',' << opcode
+            << '\n';
+        auto &line = lines[origin.line];
+        line.first++;
+        line.second += Instruction::getExecutionTime(opcode);
+    }
+    out << "\nline,instructions,cost\n";
+    for (auto &[line, summary] : lines)
+        out << line << ',' << summary.first << ',' << summary.second << '\n';
+
+    const std::string &text = out.str();
+    mapFile.write(text.data(), text.size());
+}
+
+// Cells holding addresses (procedure arguments, array element pointers) are
+// known before any code using them is emitted, so opcodes are chosen then.
+void CodeGenerator::markPointer(unsigned long address) {
+    if (address >= pointers.size()) pointers.resize(address + 1, false);
+    pointers[address] = true;
+}
+
+// Array element pointers live until the end of the statement that computed
+// them. For FOR loops that is the whole loop, as the bound is read through
+// the pointer on every iteration.
+unsigned long CodeGenerator::leasePointer() {
+    auto &temps = statementTemps.back();
+    temps.emplace_back(memory);
+    markPointer(temps.back().address);
+    return temps.back().address;
+}
+
+void CodeGenerator::releaseStatementTemps() {
+    for (auto &temp : statementTemps.back()) pointers[temp.address] = false;
+    statementTemps.pop_back();
+}
+
+bool CodeGenerator::isPointer(unsigned long address) const {
+    return address < pointers.size() && pointers[address];
+}
+
+Opcode CodeGenerator::accessThrough(Opcode opcode, unsigned long address) {
+    if (isPointer(address)) updateOpcode(opcode);
+    return opcode;
+}
+
 void CodeGenerator::updateOpcode(Opcode &opcode) {
     switch (opcode) {
         case LOAD: {
@@ -701,10 +1067,9 @@ void CodeGenerator::updateOpcode(Opcode &opcode) {
 }
 
 void CodeGenerator::jumpToMain() {
-    std::string label = "main";
-    auto reduction = lineCounter * -1;
-    markers.emplace_back(label, reduction);
-    instructions.emplace_back(JUMP, label);
+    mainLabel = newLabel();
+    jumpToMainLine = lineCounter;
+    instructions.emplace_back(JUMP, Label{mainLabel});
     lineCounter++;
 }
 
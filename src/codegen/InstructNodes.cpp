@@ -1,5 +1,9 @@
 #include "InstructNodes.hpp"
 
+#include <algorithm>
+#include <map>
+#include <utility>
+
 namespace codegen {
 
 Node::Node(Memory &memory)
@@ -7,6 +11,7 @@ Node::Node(Memory &memory)
       identifier1(0),
       identifier2(0),
       codeGenerated(false),
+      label(0),
       memory(memory) {}
 
 NodeReadyToGenerateCode Node::addVariable(unsigned long &var) {
@@ -45,7 +50,7 @@ std::vector<Instruction> AssignNode::generateCode() {
         instructions.emplace_back(LOAD, identifier2);
         instructions.emplace_back(STORE, identifier1);
         codeGenerated = true;
-        return instructions;
+        return std::move(instructions);
     }
 
     if (!identifier3.has_value())
@@ -65,24 +70,20 @@ std::vector<Instruction> AssignNode::generateCode() {
             break;
         }
         case MULTIPLY: {
-            auto freeReg1 = memory.getFreeRegister();
-            memory.lockReg(freeReg1);
+            if (multiplyByConstant()) break;
+
+            TempCell freeReg1(memory);
             instructions.emplace_back(LOAD, identifier2);
             instructions.emplace_back(STORE, freeReg1, true);
 
-            auto freeReg2 = memory.getFreeRegister();
-            memory.lockReg(freeReg2);
+            TempCell freeReg2(memory);
             instructions.emplace_back(LOAD, identifier3.value());
             instructions.emplace_back(STORE, freeReg2, true);
 
-            auto freeReg3 = memory.getFreeRegister();
-            memory.lockReg(freeReg3);
-            auto freeReg4 = memory.getFreeRegister();
-            memory.lockReg(freeReg4);
-            auto freeReg5 = memory.getFreeRegister();
-            memory.lockReg(freeReg5);
-            auto freeReg6 = memory.getFreeRegister();
-            memory.lockReg(freeReg6);
+            TempCell freeReg3(memory);
+            TempCell freeReg4(memory);
+            TempCell freeReg5(memory);
+            TempCell freeReg6(memory);
 
             int jump1 = 46;
             int jump2 = 40;
@@ -138,42 +139,27 @@ std::vector<Instruction> AssignNode::generateCode() {
             instructions.emplace_back(LOAD, freeReg5, true);
             instructions.emplace_back(STORE, identifier1);
 
-            memory.unlockReg(freeReg1);
-            memory.unlockReg(freeReg2);
-            memory.unlockReg(freeReg3);
-            memory.unlockReg(freeReg4);
-            memory.unlockReg(freeReg5);
-            memory.unlockReg(freeReg6);
-
             break;
         }
         case DIVIDE: {
-            auto dividend = memory.getFreeRegister();
-            memory.lockReg(dividend);
+            if (divideByConstant(false)) break;
+
+            TempCell dividend(memory);
             instructions.emplace_back(LOAD, identifier2);
             instructions.emplace_back(STORE, dividend, true);
 
-            auto divisor = memory.getFreeRegister();
-            memory.lockReg(divisor);
+            TempCell divisor(memory);
             instructions.emplace_back(LOAD, identifier3.value());
-            instructions.emplace_back(STORE, divisor);
-
-            auto freeReg3 = memory.getFreeRegister();
-            memory.lockReg(freeReg3);
-            auto freeReg4 = memory.getFreeRegister();
-            memory.lockReg(freeReg4);
-            auto freeReg5 = memory.getFreeRegister();
-            memory.lockReg(freeReg5);
-            auto freeReg6 = memory.getFreeRegister();
-            memory.lockReg(freeReg6);
-            auto freeReg7 = memory.getFreeRegister();
-            memory.lockReg(freeReg7);
-            auto freeReg8 = memory.getFreeRegister();
-            memory.lockReg(freeReg8);
-            auto freeReg9 = memory.getFreeRegister();
-            memory.lockReg(freeReg9);
-            auto freeReg10 = memory.getFreeRegister();
-            memory.lockReg(freeReg10);
+            instructions.emplace_back(STORE, divisor, true);
+
+            TempCell freeReg3(memory);
+            TempCell freeReg4(memory);
+            TempCell freeReg5(memory);
+            TempCell freeReg6(memory);
+            TempCell freeReg7(memory);
+            TempCell freeReg8(memory);
+            TempCell freeReg9(memory);
+            TempCell freeReg10(memory);
 
             instructions.emplace_back(SET, 1, true);
             instructions.emplace_back(STORE, freeReg3, true);
@@ -305,49 +291,28 @@ std::vector<Instruction> AssignNode::generateCode() {
             instructions.emplace_back(LOAD, freeReg7, true);
             instructions.emplace_back(STORE, identifier1);
 
-            // Unlock registers
-            memory.unlockReg(freeReg3);
-            memory.unlockReg(freeReg4);
-            memory.unlockReg(freeReg5);
-            memory.unlockReg(freeReg6);
-            memory.unlockReg(freeReg7);
-            memory.unlockReg(freeReg8);
-            memory.unlockReg(freeReg9);
-            memory.unlockReg(freeReg10);
-
             break;
         }
         case MOD: {
-            auto dividend = memory.getFreeRegister();
-            memory.lockReg(dividend);
+            if (divideByConstant(true)) break;
+
+            TempCell dividend(memory);
             instructions.emplace_back(LOAD, identifier2);
             instructions.emplace_back(STORE, dividend, true);
 
-            auto divisor = memory.getFreeRegister();
-            memory.lockReg(divisor);
+            TempCell divisor(memory);
             instructions.emplace_back(LOAD, identifier3.value());
             instructions.emplace_back(STORE, divisor, true);
 
-            auto reg1 = memory.getFreeRegister();
-            memory.lockReg(reg1);
-            auto reg2 = memory.getFreeRegister();
-            memory.lockReg(reg2);
-            auto reg3 = memory.getFreeRegister();
-            memory.lockReg(reg3);
-            auto reg4 = memory.getFreeRegister();
-            memory.lockReg(reg4);
-            auto reg5 = memory.getFreeRegister();
-            memory.lockReg(reg5);
-            auto reg6 = memory.getFreeRegister();
-            memory.lockReg(reg6);
-            auto reg7 = memory.getFreeRegister();
-            memory.lockReg(reg7);
-            auto reg8 = memory.getFreeRegister();
-            memory.lockReg(reg8);
-            auto reg9 = memory.getFreeRegister();
-            memory.lockReg(reg9);
-            auto reg10 = memory.getFreeRegister();
-            memory.lockReg(reg10);
+            TempCell reg1(memory);
+            TempCell reg2(memory);
+            TempCell reg3(memory);
+            TempCell reg4(memory);
+            TempCell reg5(memory);
+            TempCell reg6(memory);
+            TempCell reg8(memory);
+            TempCell reg9(memory);
+            TempCell reg10(memory);
 
             instructions.emplace_back(SET, 1, true);
             instructions.emplace_back(STORE, reg1, true);
@@ -367,7 +332,7 @@ std::vector<Instruction> AssignNode::generateCode() {
             instructions.emplace_back(JPOS, 5, true);
             instructions.emplace_back(JNEG, 4, true);
             instructions.emplace_back(LOAD, reg2, true);
-            instructions.emplace_back(STORE, reg7, true);
+            instructions.emplace_back(STORE, reg8, true);
             instructions.emplace_back(JUMP, 94, true);
             instructions.emplace_back(LOAD, reg2, true);
             instructions.emplace_back(STORE, reg6, true);
@@ -465,18 +430,6 @@ std::vector<Instruction> AssignNode::generateCode() {
             instructions.emplace_back(LOAD, reg8, true);
             instructions.emplace_back(STORE, identifier1);
 
-            // Unlock registers
-            memory.unlockReg(reg1);
-            memory.unlockReg(reg2);
-            memory.unlockReg(reg3);
-            memory.unlockReg(reg4);
-            memory.unlockReg(reg5);
-            memory.unlockReg(reg6);
-            memory.unlockReg(reg7);
-            memory.unlockReg(reg8);
-            memory.unlockReg(reg9);
-            memory.unlockReg(reg10);
-
             break;
         }
         case NOT_DEFINED:
@@ -485,7 +438,316 @@ std::vector<Instruction> AssignNode::generateCode() {
     }
 
     codeGenerated = true;
-    return instructions;
+    return std::move(instructions);
+}
+
+enum ChainStep { DOUBLE, PLUS_ONCE, MINUS_ONCE };
+
+// Fewest steps building n * y from y with doubling and adding or
+// subtracting y once: an odd n comes from n - 1 or n + 1.
+static int chainLength(unsigned long long n,
+                       std::map<unsigned long long, int> &memo) {
+    if (n == 1) return 0;
+    auto known = memo.find(n);
+    if (known != memo.end()) return known->second;
+    int length = n % 2 == 0 ? chainLength(n / 2, memo) + 1
+                            : std::min(chainLength(n - 1, memo),
+                                       chainLength(n + 1, memo)) +
+                                  1;
+    memo[n] = length;
+    return length;
+}
+
+static void chainSteps(unsigned long long n,
+                       std::map<unsigned long long, int> &memo,
+                       std::vector<ChainStep> &steps) {
+    if (n == 1) return;
+    if (n % 2 == 0) {
+        chainSteps(n / 2, memo, steps);
+        steps.push_back(DOUBLE);
+    } else if (chainLength(n - 1, memo) <= chainLength(n + 1, memo)) {
+        chainSteps(n - 1, memo, steps);
+        steps.push_back(PLUS_ONCE);
+    } else {
+        chainSteps(n + 1, memo, steps);
+        steps.push_back(MINUS_ONCE);
+    }
+}
+
+// Base cost of the MULTIPLY loop with n as its multiplier, the cheapest it
+// gets: set-up and sign handling about 250, every bit of n about 165 and
+// 30 more for a set one.
+static long multiplyLoopCost(unsigned long long n) {
+    long cost = 250;
+    for (; n; n /= 2) cost += 165 + (n % 2 ? 30 : 0);
+    return cost;
+}
+
+// y * c as straight-line code: y doubled with ADD 0 and y added or
+// subtracted along the shortest chain (y kept in a scratch cell for that),
+// negated first for a negative c. Used when it costs less than the loop.
+bool AssignNode::multiplyByConstant() {
+    unsigned long variable;
+    long long constant;
+    if (constant3.has_value()) {
+        variable = identifier2;
+        constant = constant3.value();
+    } else if (constant2.has_value()) {
+        variable = identifier3.value();
+        constant = constant2.value();
+    } else {
+        return false;
+    }
+
+    std::vector<Instruction> chain;
+    if (constant == 0) {
+        chain.emplace_back(SET, 0, true);
+        chain.emplace_back(STORE, identifier1);
+    } else {
+        unsigned long long n = constant < 0
+                                   ? 0ULL - static_cast<unsigned long long>(constant)
+                                   : static_cast<unsigned long long>(constant);
+        std::map<unsigned long long, int> memo;
+        std::vector<ChainStep> steps;
+        chainSteps(n, memo, steps);
+        bool negative = constant < 0;
+        bool keepY = negative ||
+                     static_cast<size_t>(std::count(
+                         steps.begin(), steps.end(), DOUBLE)) != steps.size();
+
+        std::optional<TempCell> y;
+        chain.emplace_back(LOAD, variable);
+        if (keepY) {
+            y.emplace(memory);
+            chain.emplace_back(STORE, *y, true);
+        }
+        if (negative) {
+            chain.emplace_back(SUB, *y, true);
+            chain.emplace_back(SUB, *y, true);
+        }
+        for (auto step : steps) {
+            if (step == DOUBLE)
+                chain.emplace_back(ADD, 0, true);
+            else
+                chain.emplace_back((step == PLUS_ONCE) != negative ? ADD : SUB,
+                                   *y, true);
+        }
+        chain.emplace_back(STORE, identifier1);
+
+        long cost = 0;
+        for (auto &i : chain) cost += Instruction::getExecutionTime(i.opcode);
+        if (cost >= multiplyLoopCost(n)) return false;
+    }
+    instructions = std::move(chain);
+    return true;
+}
+
+// Kernel code with jumps to places marked later; finish() turns them into
+// the relative distances the machine uses.
+struct KernelCode {
+    std::vector<Instruction> code;
+    std::vector<long> places;                      // instruction index
+    std::vector<std::pair<size_t, size_t>> jumps;  // instruction, place
+
+    size_t place() {
+        places.push_back(-1);
+        return places.size() - 1;
+    }
+    void mark(size_t place) { places[place] = code.size(); }
+    void emit(Opcode opcode, long value = 0) {
+        code.emplace_back(opcode, value, true);
+    }
+    void jump(Opcode opcode, size_t place) {
+        jumps.emplace_back(code.size(), place);
+        emit(opcode);
+    }
+    std::vector<Instruction> finish() {
+        for (auto [at, place] : jumps)
+            code[at].value = places[place] - static_cast<long>(at);
+        return std::move(code);
+    }
+};
+
+// Binary search for the highest step j in first..last with m * 2^j <= r
+// (-1: none, straight to the end); sets d to m * 2^j and enters there.
+static void enterDivision(KernelCode &kernel, long first, long last,
+                          unsigned long long m, unsigned long r,
+                          unsigned long d, const std::vector<size_t> &steps,
+                          size_t end) {
+    if (first == last) {
+        if (first < 0) {
+            kernel.jump(JUMP, end);
+            return;
+        }
+        kernel.emit(SET, static_cast<long>(m << first));
+        kernel.emit(STORE, d);
+        kernel.jump(JUMP, steps[first]);
+        return;
+    }
+    long middle = (first + last + 1) / 2;
+    size_t below = kernel.place();
+    kernel.emit(SET, static_cast<long>(m << middle));
+    kernel.emit(SUB, r);
+    kernel.jump(JPOS, below);
+    enterDivision(kernel, middle, last, m, r, d, steps, end);
+    kernel.mark(below);
+    enterDivision(kernel, first, middle - 1, m, r, d, steps, end);
+}
+
+// y / c and y % c for a literal c without the loops of the generic kernels,
+// with the same results: the quotient rounded towards zero, the remainder
+// with the sign of c, both 0 for c = 0. For c = ±2^k y is halved k times
+// (HALF rounds down, so a negative y is biased by 2^k - 1 first) and the
+// remainder is y less the rounded-down quotient doubled back. Any other c
+// is long division of |y| unrolled over its at most 64 - bitlen(|c|)
+// quotient bits, entered at the highest one by a binary search on |y|.
+bool AssignNode::divideByConstant(bool remainder) {
+    if (!constant3.has_value()) return false;
+    long long constant = constant3.value();
+    bool negative = constant < 0;
+    unsigned long long m = negative
+                               ? 0ULL - static_cast<unsigned long long>(constant)
+                               : static_cast<unsigned long long>(constant);
+
+    KernelCode kernel;
+    if (m == 0 || (remainder && m == 1)) {
+        kernel.emit(SET, 0);
+    } else if ((m & (m - 1)) == 0) {
+        int k = __builtin_ctzll(m);
+        TempCell y(memory);
+        kernel.code.emplace_back(LOAD, identifier2);
+        if (!remainder) {
+            if (k > 0) {
+                size_t biased = kernel.place(), done = kernel.place();
+                kernel.jump(JNEG, biased);
+                for (int i = 0; i < k; i++) kernel.emit(HALF);
+                kernel.jump(JUMP, done);
+                kernel.mark(biased);
+                kernel.emit(STORE, y);
+                kernel.emit(SET, static_cast<long>(m - 1));
+                kernel.emit(ADD, y);
+                for (int i = 0; i < k; i++) kernel.emit(HALF);
+                kernel.mark(done);
+            }
+            if (negative) {
+                kernel.emit(STORE, y);
+                kernel.emit(SUB, y);
+                kernel.emit(SUB, y);
+            }
+        } else {
+            // y - c * floor(y / c), for a negative c as y + m * floor(-y / m)
+            kernel.emit(STORE, y);
+            if (negative) {
+                kernel.emit(SUB, y);
+                kernel.emit(SUB, y);
+            }
+            for (int i = 0; i < k; i++) kernel.emit(HALF);
+            for (int i = 0; i < k; i++) kernel.emit(ADD, 0);
+            if (negative) {
+                kernel.emit(ADD, y);
+            } else {
+                TempCell multiple(memory);
+                kernel.emit(STORE, multiple);
+                kernel.emit(LOAD, y);
+                kernel.emit(SUB, multiple);
+            }
+        }
+    } else {
+        // |y| < 2^63 (for y = -2^63 |y| wraps to itself, but the first step
+        // subtracting from it wraps back to the right remainder), so the
+        // quotient has at most 64 - bitlen(m) bits
+        long quotientBits = __builtin_clzll(m);
+        TempCell sign(memory);
+        TempCell rest(memory);
+        TempCell shifted(memory);  // m * 2^j at step j
+        std::optional<TempCell> quotient, one;
+
+        size_t absolute = kernel.place();
+        kernel.code.emplace_back(LOAD, identifier2);
+        kernel.emit(STORE, sign);
+        kernel.jump(JPOS, absolute);
+        kernel.emit(SUB, sign);
+        kernel.emit(SUB, sign);
+        kernel.mark(absolute);
+        kernel.emit(STORE, rest);
+        if (!remainder) {
+            quotient.emplace(memory);
+            one.emplace(memory);
+            kernel.emit(SUB, rest);
+            kernel.emit(STORE, *quotient);
+            kernel.emit(SET, 1);
+            kernel.emit(STORE, *one);
+        }
+
+        std::vector<size_t> steps;
+        for (long j = 0; j < quotientBits; j++) steps.push_back(kernel.place());
+        size_t end = kernel.place();
+        enterDivision(kernel, -1, quotientBits - 1, m, rest, shifted, steps,
+                      end);
+
+        for (long j = quotientBits - 1; j >= 0; j--) {
+            size_t next = j > 0 ? kernel.place() : end;
+            kernel.mark(steps[j]);
+            kernel.emit(LOAD, rest);
+            kernel.emit(SUB, shifted);
+            if (remainder) {
+                kernel.jump(JNEG, next);
+                kernel.emit(STORE, rest);
+            } else {
+                size_t zero = kernel.place();
+                kernel.jump(JNEG, zero);
+                kernel.emit(STORE, rest);
+                kernel.emit(LOAD, *quotient);
+                kernel.emit(ADD, 0);
+                kernel.emit(ADD, *one);
+                kernel.emit(STORE, *quotient);
+                kernel.jump(JUMP, next);
+                kernel.mark(zero);
+                kernel.emit(LOAD, *quotient);
+                kernel.emit(ADD, 0);
+                kernel.emit(STORE, *quotient);
+            }
+            if (j > 0) {
+                kernel.mark(next);
+                kernel.emit(LOAD, shifted);
+                kernel.emit(HALF);
+                kernel.emit(STORE, shifted);
+            }
+        }
+
+        // signs: by y at run time, by c here
+        size_t negativeY = kernel.place(), done = kernel.place();
+        kernel.mark(end);
+        kernel.emit(LOAD, sign);
+        kernel.jump(JNEG, negativeY);
+        for (bool yNegative : {false, true}) {
+            if (yNegative) kernel.mark(negativeY);
+            if (!remainder) {
+                kernel.emit(LOAD, *quotient);
+                if (yNegative != negative) {
+                    kernel.emit(SUB, *quotient);
+                    kernel.emit(SUB, *quotient);
+                }
+            } else if (yNegative && negative) {
+                kernel.emit(LOAD, rest);
+                kernel.emit(SUB, rest);
+                kernel.emit(SUB, rest);
+            } else if (yNegative || negative) {
+                // m - r or r - m, unless r = 0
+                kernel.emit(LOAD, rest);
+                kernel.jump(JZERO, done);
+                kernel.emit(SET, static_cast<long>(negative ? 0 - m : m));
+                kernel.emit(negative ? ADD : SUB, rest);
+            } else {
+                kernel.emit(LOAD, rest);
+            }
+            if (!yNegative) kernel.jump(JUMP, done);
+        }
+        kernel.mark(done);
+    }
+    kernel.code.emplace_back(STORE, identifier1);
+    instructions = kernel.finish();
+    return true;
 }
 
 NodeReadyToGenerateCode AssignNode::addVariable(unsigned long &var) {
@@ -516,6 +778,8 @@ void AssignNode::clear() {
     identifier1 = 0;
     identifier2 = 0;
     identifier3.reset();
+    constant2.reset();
+    constant3.reset();
     operation = NOT_DEFINED;
     waitForThirdArg = false;
     codeGenerated = false;
@@ -527,21 +791,18 @@ ConditionNode::ConditionNode(Memory &memory)
     : Node(memory), elseExist(false), operation(UNDEF) {}
 
 std::vector<Instruction> ConditionNode::generateCode() {  // store result in acc
-    auto freeReg2 = memory.getFreeRegister();
-    memory.lockReg(freeReg2);
+    TempCell freeReg2(memory);
     instructions.emplace_back(LOAD, identifier2);
     instructions.emplace_back(STORE, freeReg2, true);
 
-    auto freeReg1 = memory.getFreeRegister();
-    memory.lockReg(freeReg1);
+    TempCell freeReg1(memory);
     instructions.emplace_back(LOAD, identifier1);
     instructions.emplace_back(STORE, freeReg1, true);
 
-    std::string jumpOverIf =
-        name;  // during generation replace jumpOverIf labe with marker
-               // standing by particular if label
-    std::string jumpOverIfIncremented =
-        name + ":inc";  // bc we have jump over "jumpOverIf" also
+    // resolved when the if body is generated
+    Label jumpOverIf = {label};
+    Label jumpOverIfIncremented = {label,
+                                   1};  // bc we have jump over "jumpOverIf" also
 
     switch (operation) {
         case EQ: {
@@ -592,29 +853,24 @@ std::vector<Instruction> ConditionNode::generateCode() {  // store result in acc
         }
     }
 
-    memory.unlockReg(freeReg1);
-    memory.unlockReg(freeReg2);
-
     codeGenerated = true;
 
-    return instructions;
+    return std::move(instructions);
 }
 
 RepeatNode::RepeatNode(Memory &memory) : Node(memory), operation(UNDEF) {}
 
 std::vector<Instruction> RepeatNode::generateCode() {  // store result in acc
-    auto freeReg2 = memory.getFreeRegister();
-    memory.lockReg(freeReg2);
+    TempCell freeReg2(memory);
     instructions.emplace_back(LOAD, identifier2);
     instructions.emplace_back(STORE, freeReg2, true);
 
-    auto freeReg1 = memory.getFreeRegister();
-    memory.lockReg(freeReg1);
+    TempCell freeReg1(memory);
     instructions.emplace_back(LOAD, identifier1);
     instructions.emplace_back(STORE, freeReg1, true);
 
-    std::string jumpToBegining = name;
-    std::string jumpToBeginingInc = name + ":inc";
+    Label jumpToBegining = {label};
+    Label jumpToBeginingInc = {label, 1};
 
     switch (operation) {
         case EQ: {
@@ -656,29 +912,24 @@ std::vector<Instruction> RepeatNode::generateCode() {  // store result in acc
         }
     }
 
-    memory.unlockReg(freeReg1);
-    memory.unlockReg(freeReg2);
-
     codeGenerated = true;
 
-    return instructions;
+    return std::move(instructions);
 }
 
 WhileNode::WhileNode(Memory &memory) : Node(memory), operation(UNDEF) {}
 
 std::vector<Instruction> WhileNode::generateCode() {  // store result in acc
-    auto freeReg2 = memory.getFreeRegister();
-    memory.lockReg(freeReg2);
+    TempCell freeReg2(memory);
     instructions.emplace_back(LOAD, identifier2);
     instructions.emplace_back(STORE, freeReg2, true);
 
-    auto freeReg1 = memory.getFreeRegister();
-    memory.lockReg(freeReg1);
+    TempCell freeReg1(memory);
     instructions.emplace_back(LOAD, identifier1);
     instructions.emplace_back(STORE, freeReg1, true);
 
-    std::string jumpOverCommands = name;
-    std::string jumpOverCommandsInc = name + ":inc";
+    Label jumpOverCommands = {label};
+    Label jumpOverCommandsInc = {label, 1};
 
     switch (operation) {
         case EQ: {
@@ -720,12 +971,9 @@ std::vector<Instruction> WhileNode::generateCode() {  // store result in acc
         }
     }
 
-    memory.unlockReg(freeReg1);
-    memory.unlockReg(freeReg2);
-
     codeGenerated = true;
 
-    return instructions;
+    return std::move(instructions);
 }
 
 ForNode::ForNode(Memory &memory) : Node(memory), iterator(0), mode(NOT_DEF) {}
@@ -736,8 +984,8 @@ std::vector<Instruction> ForNode::generateCode() {  // store result in acc
     instructions.emplace_back(LOAD, identifier1);
     instructions.emplace_back(STORE, iterator);
 
-    std::string jumpOverCommands = name;
-    std::string jumpOverCommandsInc = name + ":inc";
+    Label jumpOverCommands = {label};
+    Label jumpOverCommandsInc = {label, 1};
 
     // check if iterator reached to_val
     instructions.emplace_back(LOAD, iterator);
@@ -749,7 +997,7 @@ std::vector<Instruction> ForNode::generateCode() {  // store result in acc
 
     codeGenerated = true;
 
-    return instructions;
+    return std::move(instructions);
 };
 
 }  // namespace codegen
@@ -10,7 +10,7 @@ const std::vector<long> Instruction::executionTimes = {
     10,  // ADD
     10,  // SUB
     20,  // ADDI
-    20,  // SUBI
+    12,  // SUBI
     50,  // SET
     5,   // HALF
     1,   // JUMP
@@ -0,0 +1,450 @@
+#include "Peephole.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace codegen {
+
+const std::vector<PeepholeOptimizer::Rule> PeepholeOptimizer::rules = {
+    {"store-load", 2, &PeepholeOptimizer::storeLoad},
+    {"load-store", 2, &PeepholeOptimizer::loadStore},
+    {"dead-acc", 2, &PeepholeOptimizer::deadAccumulator},
+    {"acc-track", 1, &PeepholeOptimizer::redundantAccumulator},
+    {"dead-store", 1, &PeepholeOptimizer::deadStore},
+    {"jump-next", 1, &PeepholeOptimizer::jumpToNext},
+    {"for-step", 2, &PeepholeOptimizer::forStepUp},
+    {"for-step-down", 5, &PeepholeOptimizer::forStepDown},
+};
+
+static bool isJump(Opcode opcode) {
+    return opcode == JUMP || opcode == JPOS || opcode == JZERO ||
+           opcode == JNEG;
+}
+
+// Opcodes whose operand is a memory cell.
+static bool accessesCell(Opcode opcode) {
+    switch (opcode) {
+        case GET:
+        case PUT:
+        case LOAD:
+        case STORE:
+        case LOADI:
+        case STOREI:
+        case ADD:
+        case SUB:
+        case ADDI:
+        case SUBI:
+        case RTRN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Only the accumulator changes, nothing else is observed.
+static bool writesOnlyAccumulator(const Instruction &i) {
+    switch (i.opcode) {
+        case LOAD:
+        case LOADI:
+        case ADD:
+        case SUB:
+        case ADDI:
+        case SUBI:
+        case HALF:
+            return i.mode == VALUE;
+        case SET:
+            return i.mode == VALUE || i.mode == RVALUE;
+        default:
+            return false;
+    }
+}
+
+static bool isPlain(const Instruction &i, Opcode opcode) {
+    return i.opcode == opcode && i.mode == VALUE;
+}
+
+static std::vector<std::string> split(const std::string &rules) {
+    std::vector<std::string> names;
+    std::stringstream stream(rules);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (!name.empty()) names.push_back(name);
+    }
+    return names;
+}
+
+PeepholeOptimizer::PeepholeOptimizer(const std::string &names,
+                                     unsigned long firstScratchCell,
+                                     std::vector<unsigned long> constantCells)
+    : enabled(rules.size(), names == "all"),
+      firstScratchCell(firstScratchCell),
+      constantCells(constantCells.begin(), constantCells.end()) {
+    if (names != "all" && names != "none") {
+        for (auto &name : split(names)) {
+            auto rule = std::find_if(rules.begin(), rules.end(),
+                                     [&name](const Rule &rule) {
+                                         return name == rule.name;
+                                     });
+            if (rule == rules.end())
+                throw std::runtime_error("Unknown peephole rule: " + name);
+            enabled[rule - rules.begin()] = true;
+        }
+    }
+    for (size_t k = 0; k < rules.size(); k++) {
+        if (enabled[k]) stats.push_back({rules[k].name});
+    }
+}
+
+std::vector<std::string> PeepholeOptimizer::ruleNames() {
+    std::vector<std::string> names;
+    for (auto &rule : rules) names.push_back(rule.name);
+    return names;
+}
+
+bool PeepholeOptimizer::validRules(const std::string &names) {
+    if (names == "all" || names == "none") return true;
+    auto known = ruleNames();
+    for (auto &name : split(names)) {
+        if (std::find(known.begin(), known.end(), name) == known.end())
+            return false;
+    }
+    return true;
+}
+
+void PeepholeOptimizer::run(std::vector<Instruction> &instructions,
+                            std::vector<SourceOrigin> &sourceMap) {
+    if (stats.empty()) return;
+
+    std::vector<Slot> code;
+    code.reserve(instructions.size());
+    nextFreeCell = firstScratchCell;
+    for (size_t k = 0; k < instructions.size(); k++) {
+        const Instruction &i = instructions[k];
+        if (i.mode == LABEL)
+            throw std::runtime_error("Peephole needs resolved labels");
+        long target = -1;
+        if (i.mode == LINE)
+            target = i.value;
+        else if (isJump(i.opcode))
+            target = static_cast<long>(k) + i.value;
+        else if (accessesCell(i.opcode) && i.mode == VALUE)
+            nextFreeCell = std::max(nextFreeCell,
+                                    static_cast<unsigned long>(i.value) + 1);
+        SourceOrigin origin =
+            k < sourceMap.size() ? sourceMap[k] : SourceOrigin{0, "other"};
+        code.push_back({i, origin, target});
+    }
+
+    while (pass(code)) {
+    }
+
+    if (oneCell) {  // set the constant up before anything else runs
+        SourceOrigin origin = {0, "constants"};
+        for (auto &slot : code) {
+            if (slot.target >= 0) slot.target += 2;
+        }
+        code.insert(code.begin(), {{Instruction(SET, 1), origin, -1},
+                                   {Instruction(STORE, oneCell), origin, -1}});
+    }
+
+    instructions.clear();
+    sourceMap.clear();
+    for (size_t k = 0; k < code.size(); k++) {
+        Instruction i = code[k].instruction;
+        if (code[k].target >= 0)
+            i.value = i.mode == LINE ? code[k].target
+                                     : code[k].target - static_cast<long>(k);
+        instructions.push_back(i);
+        sourceMap.push_back(code[k].origin);
+    }
+}
+
+// One sweep over the code: at every instruction the first enabled rule whose
+// window matches replaces the window. Jump targets are then renumbered; a
+// target removed with its window moves to what follows it.
+bool PeepholeOptimizer::pass(std::vector<Slot> &code) {
+    std::vector<bool> isTarget(code.size() + 1, false);
+    for (auto &slot : code) {
+        if (slot.target >= 0) isTarget[slot.target] = true;
+    }
+    findReadCells(code);
+    trackAccumulator(code, isTarget);
+
+    std::vector<Slot> out;
+    out.reserve(code.size());
+    std::vector<long> newIndex(code.size() + 1);
+    std::vector<Instruction> replacement;
+    bool changed = false;
+    size_t at = 0;
+    while (at < code.size()) {
+        bool applied = false;
+        size_t statIndex = 0;
+        for (size_t r = 0; r < rules.size() && !applied; r++) {
+            if (!enabled[r]) continue;
+            auto &rule = rules[r];
+            auto &ruleStats = stats[statIndex++];
+            if (at + rule.window > code.size()) continue;
+            bool entered = false;
+            for (size_t k = 1; k < rule.window; k++)
+                entered = entered || isTarget[at + k];
+            if (entered) continue;
+
+            bool hadOne = oneCell != 0;
+            replacement.clear();
+            if (!(this->*rule.match)(code, at, replacement)) continue;
+
+            long cost = 0;
+            for (size_t k = 0; k < rule.window; k++)
+                cost += Instruction::getExecutionTime(code[at + k].instruction.opcode);
+            for (auto &i : replacement)
+                cost -= Instruction::getExecutionTime(i.opcode);
+            long removed = rule.window - replacement.size();
+            if (!hadOne && oneCell) {  // SET 1; STORE one added at the start
+                cost -= Instruction::getExecutionTime(SET) +
+                        Instruction::getExecutionTime(STORE);
+                removed -= 2;
+            }
+            ruleStats.applied++;
+            ruleStats.instructions += removed;
+            ruleStats.cost += cost;
+
+            for (size_t k = 0; k < rule.window; k++) newIndex[at + k] = out.size();
+            for (auto &i : replacement) out.push_back({i, code[at].origin, -1});
+            at += rule.window;
+            applied = changed = true;
+        }
+        if (!applied) {
+            newIndex[at] = out.size();
+            out.push_back(code[at]);
+            at++;
+        }
+    }
+    newIndex[code.size()] = out.size();
+
+    for (auto &slot : out) {
+        if (slot.target >= 0) slot.target = newIndex[slot.target];
+    }
+    code.swap(out);
+    return changed;
+}
+
+void PeepholeOptimizer::findReadCells(const std::vector<Slot> &code) {
+    readCells.assign(nextFreeCell - firstScratchCell, false);
+    readConstants.clear();
+    for (auto &slot : code) {
+        const Instruction &i = slot.instruction;
+        if (i.mode != VALUE || !accessesCell(i.opcode) || i.opcode == STORE ||
+            i.opcode == GET)
+            continue;
+        if (isScratch(i.value))
+            readCells[i.value - firstScratchCell] = true;
+        else if (constantCells.count(i.value))
+            readConstants.insert(i.value);
+    }
+}
+
+bool PeepholeOptimizer::isUnread(unsigned long cell) const {
+    if (isScratch(cell)) return !readCells[cell - firstScratchCell];
+    return constantCells.count(cell) && !readConstants.count(cell);
+}
+
+// Forward pass over every basic block keeping the cells the accumulator
+// equals and the constant it holds, if known. A LOAD, SET or STORE that
+// would leave both unchanged is redundant. Blocks start at jump targets and
+// after unconditional jumps, where nothing is known. Only STORE and STOREI
+// write memory and both write the accumulator, so a STOREI through an
+// unknown pointer keeps every fact; any other write to a tracked cell is a
+// GET, which drops it. Whatever the other rules do to a window in the same
+// pass leaves the accumulator after it as it was, so the facts hold.
+void PeepholeOptimizer::trackAccumulator(const std::vector<Slot> &code,
+                                         const std::vector<bool> &isTarget) {
+    redundant.assign(code.size(), false);
+    std::vector<long> cells;       // equal to the accumulator
+    bool knownConstant = false;    // SET of constant (VALUE or RVALUE mode)
+    Instruction constant(SET, 0);
+    auto forget = [&]() {
+        cells.clear();
+        knownConstant = false;
+    };
+    auto holds = [&cells](long cell) {  // cell 0 is the accumulator
+        return cell == 0 ||
+               std::find(cells.begin(), cells.end(), cell) != cells.end();
+    };
+
+    for (size_t k = 0; k < code.size(); k++) {
+        const Instruction &i = code[k].instruction;
+        if (isTarget[k]) forget();
+        switch (i.opcode) {
+            case LOAD:
+                if (holds(i.value)) {
+                    redundant[k] = true;
+                } else {
+                    forget();
+                    cells.push_back(i.value);
+                }
+                break;
+            case SET:
+                if (i.mode == LINE) {
+                    forget();
+                } else if (knownConstant && constant.mode == i.mode &&
+                           constant.value == i.value) {
+                    redundant[k] = true;
+                } else {
+                    forget();
+                    knownConstant = true;
+                    constant = i;
+                }
+                break;
+            case STORE:
+                if (holds(i.value))
+                    redundant[k] = true;
+                else
+                    cells.push_back(i.value);
+                break;
+            case STOREI:
+            case PUT:
+                break;
+            case GET:
+                if (i.value == 0)
+                    forget();
+                else
+                    cells.erase(std::remove(cells.begin(), cells.end(), i.value),
+                                cells.end());
+                break;
+            case JPOS:
+            case JZERO:
+            case JNEG:
+                break;  // the fall-through path keeps the accumulator
+            default:  // arithmetic, LOADI, JUMP, RTRN, HALT
+                forget();
+                break;
+        }
+    }
+}
+
+bool PeepholeOptimizer::isScratch(unsigned long cell) const {
+    return cell >= firstScratchCell && cell < nextFreeCell;
+}
+
+unsigned long PeepholeOptimizer::constantOne() {
+    if (!oneCell) oneCell = nextFreeCell++;
+    return oneCell;
+}
+
+// STORE r; LOAD r -> STORE r (also STOREI p; LOADI p)
+bool PeepholeOptimizer::storeLoad(const std::vector<Slot> &code, size_t at,
+                                  std::vector<Instruction> &out) {
+    auto &a = code[at].instruction;
+    auto &b = code[at + 1].instruction;
+    if (a.value != b.value) return false;
+    if (!(isPlain(a, STORE) && isPlain(b, LOAD)) &&
+        !(isPlain(a, STOREI) && isPlain(b, LOADI)))
+        return false;
+    out.push_back(a);
+    return true;
+}
+
+// LOAD x; STORE x -> LOAD x (also LOADI p; STOREI p)
+bool PeepholeOptimizer::loadStore(const std::vector<Slot> &code, size_t at,
+                                  std::vector<Instruction> &out) {
+    auto &a = code[at].instruction;
+    auto &b = code[at + 1].instruction;
+    if (a.value != b.value) return false;
+    if (!(isPlain(a, LOAD) && isPlain(b, STORE)) &&
+        !(isPlain(a, LOADI) && isPlain(b, STOREI)))
+        return false;
+    out.push_back(a);
+    return true;
+}
+
+// An accumulator value overwritten before it is used: X; LOAD y -> LOAD y
+bool PeepholeOptimizer::deadAccumulator(const std::vector<Slot> &code,
+                                        size_t at,
+                                        std::vector<Instruction> &out) {
+    auto &a = code[at].instruction;
+    auto &b = code[at + 1].instruction;
+    if (!writesOnlyAccumulator(a)) return false;
+    if (!isPlain(b, LOAD) && !isPlain(b, LOADI) &&
+        !(b.opcode == SET && (b.mode == VALUE || b.mode == RVALUE)))
+        return false;
+    out.push_back(b);
+    return true;
+}
+
+// Scratch and constant cells are never reached through pointers, so a
+// store to one that no instruction reads is dead.
+bool PeepholeOptimizer::deadStore(const std::vector<Slot> &code, size_t at,
+                                  std::vector<Instruction> &out) {
+    auto &a = code[at].instruction;
+    return isPlain(a, STORE) && isUnread(a.value);
+}
+
+bool PeepholeOptimizer::jumpToNext(const std::vector<Slot> &code, size_t at,
+                                   std::vector<Instruction> &out) {
+    return isJump(code[at].instruction.opcode) &&
+           code[at].instruction.mode == VALUE &&
+           code[at].target == static_cast<long>(at) + 1;
+}
+
+// A LOAD, SET or STORE found redundant by trackAccumulator.
+bool PeepholeOptimizer::redundantAccumulator(const std::vector<Slot> &code,
+                                             size_t at,
+                                             std::vector<Instruction> &out) {
+    return redundant[at];
+}
+
+// FOR ... TO step: SET 1; ADD i -> LOAD i; ADD one, with one set up once.
+bool PeepholeOptimizer::forStepUp(const std::vector<Slot> &code, size_t at,
+                                  std::vector<Instruction> &out) {
+    auto &a = code[at].instruction;
+    auto &b = code[at + 1].instruction;
+    if (!isPlain(a, SET) || a.value != 1 || !isPlain(b, ADD)) return false;
+    out.emplace_back(LOAD, b.value);
+    out.emplace_back(ADD, constantOne());
+    return true;
+}
+
+// FOR ... DOWNTO step: SET 1; STORE t; LOAD i; SUB t; STORE i
+// -> LOAD i; SUB one; STORE i. t is a scratch cell leased for the step
+// only, nothing reads it afterwards without storing first.
+bool PeepholeOptimizer::forStepDown(const std::vector<Slot> &code, size_t at,
+                                    std::vector<Instruction> &out) {
+    auto &set = code[at].instruction;
+    auto &store = code[at + 1].instruction;
+    auto &load = code[at + 2].instruction;
+    auto &sub = code[at + 3].instruction;
+    auto &back = code[at + 4].instruction;
+    if (!isPlain(set, SET) || set.value != 1 || !isPlain(store, STORE) ||
+        !isScratch(store.value) || !isPlain(load, LOAD) ||
+        !isPlain(sub, SUB) || sub.value != store.value ||
+        !isPlain(back, STORE) || back.value != load.value ||
+        load.value == store.value)
+        return false;
+    out.push_back(load);
+    out.emplace_back(SUB, constantOne());
+    out.push_back(back);
+    return true;
+}
+
+void PeepholeOptimizer::printReport(std::ostream &os) const {
+    os << "Peephole optimizer:\n";
+    os << std::left << std::setw(16) << "  rule" << std::right << std::setw(10)
+       << "applied" << std::setw(14) << "instructions" << std::setw(12)
+       << "base cost" << '\n';
+    PeepholeStats total = {"total"};
+    for (auto &rule : stats) {
+        os << "  " << std::left << std::setw(14) << rule.rule << std::right
+           << std::setw(10) << rule.applied << std::setw(14)
+           << rule.instructions << std::setw(12) << rule.cost << '\n';
+        total.applied += rule.applied;
+        total.instructions += rule.instructions;
+        total.cost += rule.cost;
+    }
+    os << "  " << std::left << std::setw(14) << total.rule << std::right
+       << std::setw(10) << total.applied << std::setw(14) << total.instructions
+       << std::setw(12) << total.cost << '\n';
+}
+
+}  // namespace codegen
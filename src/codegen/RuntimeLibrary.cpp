@@ -0,0 +1,117 @@
+#include "RuntimeLibrary.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace codegen {
+
+RuntimeLibrary::RuntimeLibrary(long inlineLimit) : inlineLimit(inlineLimit) {}
+
+std::vector<bool> RuntimeLibrary::plan(const std::vector<ArithmeticSite> &sites,
+                                       Memory &memory) {
+    std::map<AssignOperation, int> uses;
+    for (auto &site : sites) uses[site.operation]++;
+
+    std::vector<size_t> order(sites.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sites](size_t a, size_t b) {
+        return sites[a].loopDepth > sites[b].loopDepth;
+    });
+
+    std::vector<bool> calls(sites.size(), false);
+    std::map<AssignOperation, long> sizes;
+    Memory probe(0);
+    long budget = inlineLimit;
+    for (size_t k : order) {
+        auto operation = sites[k].operation;
+        if (uses[operation] < 2) continue;
+        if (!sizes.count(operation))
+            sizes[operation] = kernel(operation, probe, 0, 0, 0).size();
+        if (sizes[operation] <= budget) {
+            budget -= sizes[operation];
+            continue;
+        }
+        calls[k] = true;
+    }
+
+    // a routine with one caller is no smaller than its kernel inline
+    std::map<AssignOperation, int> callers;
+    for (size_t k = 0; k < sites.size(); k++) {
+        if (calls[k]) callers[sites[k].operation]++;
+    }
+    for (size_t k = 0; k < sites.size(); k++) {
+        if (calls[k] && callers[sites[k].operation] < 2) calls[k] = false;
+    }
+    for (auto &[operation, count] : callers) {
+        if (count >= 2) generate(operation, memory);
+    }
+    return calls;
+}
+
+std::vector<Instruction> RuntimeLibrary::call(AssignOperation operation,
+                                              unsigned long result,
+                                              unsigned long left,
+                                              unsigned long right,
+                                              long firstLine) const {
+    auto &routine = routines.at(operation);
+    std::vector<Instruction> code;
+    code.emplace_back(LOAD, left);
+    code.emplace_back(STORE, routine.left, true);
+    code.emplace_back(LOAD, right);
+    code.emplace_back(STORE, routine.right, true);
+    code.push_back(Instruction::line(SET, firstLine + 7));
+    code.emplace_back(STORE, routine.returnCell, true);
+    code.emplace_back(JUMP, 0, true);
+    code.emplace_back(STORE, result);
+    return code;
+}
+
+std::vector<Instruction> RuntimeLibrary::place(long firstLine) {
+    std::vector<Instruction> code;
+    for (auto &[operation, routine] : routines) {
+        routine.start = firstLine + code.size();
+        code.insert(code.end(), routine.code.begin(), routine.code.end());
+    }
+    return code;
+}
+
+long RuntimeLibrary::start(AssignOperation operation) const {
+    return routines.at(operation).start;
+}
+
+std::vector<Instruction> RuntimeLibrary::kernel(AssignOperation operation,
+                                                Memory &memory,
+                                                unsigned long result,
+                                                unsigned long left,
+                                                unsigned long right) {
+    AssignNode node(memory);
+    node.waitForThirdArg = true;
+    node.operation = operation;
+    node.addVariable(result);
+    node.addVariable(left);
+    node.addVariable(right);
+    return node.generateCode();
+}
+
+// The kernel without its first four instructions, which copy the operands
+// to the cells it works on (the call stores them there), and with RTRN in
+// place of the store of the result, where every path ends with the result
+// in the accumulator.
+void RuntimeLibrary::generate(AssignOperation operation, Memory &memory) {
+    TempCell returnCell(memory);
+    auto code = kernel(operation, memory, 0, 0, 0);
+    if (code.size() < 5 || code[0].opcode != LOAD || code[1].opcode != STORE ||
+        code[2].opcode != LOAD || code[3].opcode != STORE ||
+        code.back().opcode != STORE || code.back().doNotModify)
+        throw std::runtime_error("Kernel does not start with its operands");
+
+    Routine &routine = routines[operation];
+    routine.left = code[1].value;
+    routine.right = code[3].value;
+    routine.returnCell = returnCell;
+    routine.code.assign(code.begin() + 4, code.end());
+    routine.code.back() = Instruction(RTRN, returnCell, true);
+}
+
+}  // namespace codegen
@@ -1,12 +1,32 @@
 #include "CompilerInterface.hpp"
 
+#include <fstream>
+
+#include "ConstantFolder.hpp"
+#include "IRBuilder.hpp"
+#include "IRLowering.hpp"
+
 namespace compiler {
 
 semana::ExitCode Compiler::compile(ast::ProgramAllNode* astRoot,
                                    std::string& inputFile,
-                                   std::string& outputFile) {
+                                   std::string& outputFile,
+                                   const Options& options) {
     context.astRoot = astRoot;
     context.outputFile = outputFile;
+    context.mapFile = options.mapFile;
+    context.irFile = options.irFile;
+    context.viaIr = options.viaIr;
+    context.peepholeRules = options.peepholeRules;
+    context.peepholeReport = options.peepholeReport;
+    context.inlineLimit = options.inlineLimit;
+
+    if (options.constantFolding) {
+        ast::ConstantFolder folder;
+        folder.fold(astRoot);
+        std::cout << "Constant folding replaced " << folder.getFolded()
+                  << " expressions and reads.\n";
+    }
 
     semana::SemanticAnalyzer semAnalyzer(inputFile);
     std::cout << "Starting semantic analyzer ...\n";
@@ -19,6 +39,25 @@ semana::ExitCode Compiler::compile(ast::ProgramAllNode* astRoot,
     }
 
     codegen::CodeGenerator codeGenerator(context);
+    if (context.viaIr || !context.irFile.empty()) {
+        ir::Module module = ir::IRBuilder(context).build();
+        if (!context.irFile.empty()) {
+            std::ofstream irOut(context.irFile);
+            if (!irOut.is_open()) {
+                throw std::runtime_error("Unable to open " + context.irFile +
+                                         " for writing.");
+            }
+            ir::print(irOut, module);
+        }
+        if (context.viaIr) {
+            ir::LoweredCode code =
+                ir::IRLowering(module, context.symbolTable.getLastUsedAddr(),
+                               context.inlineLimit)
+                    .lower();
+            return codeGenerator.saveCode(std::move(code.instructions),
+                                          std::move(code.sourceMap));
+        }
+    }
     exitCode = codeGenerator.generateCode();
 
     return exitCode;
@@ -0,0 +1,109 @@
+#include "Cost.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace costan {
+
+static long long saturatedAdd(long long a, long long b) {
+    long long result;
+    return __builtin_add_overflow(a, b, &result) ? LLONG_MAX : result;
+}
+
+static long long saturatedMul(long long a, long long b) {
+    long long result;
+    return __builtin_mul_overflow(a, b, &result) ? LLONG_MAX : result;
+}
+
+Cost::Cost(long long constant) { terms[{}] = {constant, constant}; }
+
+Cost &Cost::operator+=(const Cost &other) {
+    for (auto &[monomial, range] : other.terms) {
+        Range &sum = terms[monomial];
+        sum.min = saturatedAdd(sum.min, range.min);
+        sum.max = saturatedAdd(sum.max, range.max);
+    }
+    noUpperBound = noUpperBound || other.noUpperBound;
+    return *this;
+}
+
+Cost Cost::times(long long factor) const {
+    Cost result;
+    result.noUpperBound = noUpperBound && factor != 0;
+    if (factor == 0) return result;
+    for (auto &[monomial, range] : terms) {
+        result.terms[monomial] = {saturatedMul(range.min, factor),
+                                  saturatedMul(range.max, factor)};
+    }
+    return result;
+}
+
+Cost Cost::timesSymbol(int symbol) const {
+    Cost result;
+    result.noUpperBound = noUpperBound;
+    for (auto &[monomial, range] : terms) {
+        Monomial product = monomial;
+        product.insert(std::upper_bound(product.begin(), product.end(), symbol),
+                       symbol);
+        result.terms[product] = range;
+    }
+    return result;
+}
+
+Cost Cost::hull(const Cost &other) const {
+    Cost result;
+    result.noUpperBound = noUpperBound || other.noUpperBound;
+    auto merge = [&result](const Cost &a, const Cost &b) {
+        for (auto &[monomial, range] : a.terms) {
+            auto it = b.terms.find(monomial);
+            Range missing;  // term absent on the other side
+            const Range &otherRange = it != b.terms.end() ? it->second : missing;
+            result.terms[monomial] = {std::min(range.min, otherRange.min),
+                                      std::max(range.max, otherRange.max)};
+        }
+    };
+    merge(*this, other);
+    merge(other, *this);
+    return result;
+}
+
+Cost Cost::unbounded() {
+    Cost result;
+    result.noUpperBound = true;
+    return result;
+}
+
+bool Cost::exact() const {
+    if (noUpperBound) return false;
+    for (auto &[monomial, range] : terms) {
+        if (!monomial.empty() || !range.exact()) return false;
+    }
+    return true;
+}
+
+Range Cost::constant() const {
+    auto it = terms.find({});
+    return it != terms.end() ? it->second : Range();
+}
+
+std::ostream &operator<<(std::ostream &os, const Range &range) {
+    if (range.exact()) return os << range.min;
+    return os << range.min << ".." << range.max;
+}
+
+std::ostream &operator<<(std::ostream &os, const Cost &cost) {
+    os << cost.constant();
+    for (auto &[monomial, range] : cost.getTerms()) {
+        if (monomial.empty() || range.max == 0) continue;
+        os << " + ";
+        if (range.exact())
+            os << range.min;
+        else
+            os << '[' << range << ']';
+        for (int symbol : monomial) os << "*n" << symbol;
+    }
+    if (cost.isUnbounded()) os << " + ?";
+    return os;
+}
+
+}  // namespace costan
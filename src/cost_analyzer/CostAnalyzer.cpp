@@ -0,0 +1,461 @@
+#include "CostAnalyzer.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+#include <optional>
+
+namespace costan {
+
+static bool isJump(Opcode opcode) {
+    return opcode == JUMP || opcode == JPOS || opcode == JZERO ||
+           opcode == JNEG;
+}
+
+static void widen(std::optional<Cost> &bound, const Cost &cost) {
+    bound = bound ? bound->hull(cost) : cost;
+}
+
+CostAnalyzer::CostAnalyzer(const Program &program) : program(program) {}
+
+CostReport CostAnalyzer::analyze() {
+    report = CostReport();
+    procedures.clear();
+    report.instructions = program.size();
+    if (program.empty()) return report;
+
+    buildBlocks();
+    report.blocks = blocks.size();
+    report.total = analyzeRegion(0);
+    std::sort(report.procedures.begin(), report.procedures.end(),
+              [](const ProcedureReport &a, const ProcedureReport &b) {
+                  return a.entry < b.entry;
+              });
+    return report;
+}
+
+long long CostAnalyzer::target(size_t index) const {
+    return static_cast<long long>(index) + program[index].operand;
+}
+
+bool CostAnalyzer::isCall(size_t index) const {
+    return index >= 2 && program[index].opcode == JUMP &&
+           program[index - 2].opcode == SET &&
+           program[index - 2].operand == static_cast<long long>(index + 1) &&
+           program[index - 1].opcode == STORE;
+}
+
+void CostAnalyzer::buildBlocks() {
+    size_t n = program.size();
+    auto inProgram = [n](long long index) {
+        return index >= 0 && index < static_cast<long long>(n);
+    };
+
+    blocks.clear();
+    stores.clear();
+    addressTaken.clear();
+    std::set<long long> pointers;  // cells dereferenced by LOADI & co.
+    for (auto &instruction : program) {
+        Opcode opcode = instruction.opcode;
+        if (opcode == LOADI || opcode == STOREI || opcode == ADDI ||
+            opcode == SUBI)
+            pointers.insert(instruction.operand);
+    }
+
+    std::vector<bool> leader(n + 1, false);
+    leader[0] = true;
+    for (size_t i = 0; i < n; i++) {
+        Opcode opcode = program[i].opcode;
+        if (isJump(opcode) && inProgram(target(i))) leader[target(i)] = true;
+        if (isJump(opcode) || opcode == RTRN || opcode == HALT)
+            leader[i + 1] = true;
+        if (opcode == STORE) stores[program[i].operand].push_back(i);
+
+        // SET k is an address when k ends up in a dereferenced cell
+        // (reference arguments, array element pointers); constants and
+        // return addresses of calls are not.
+        if (opcode == SET && !(i + 2 < n && isCall(i + 2))) {
+            bool storedAsValue = i + 1 < n && program[i + 1].opcode == STORE &&
+                                 !pointers.count(program[i + 1].operand);
+            if (!storedAsValue) addressTaken.insert(program[i].operand);
+        }
+    }
+
+    blockOf.assign(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (leader[i]) blocks.push_back({i, i, 0, {}});
+        blocks.back().last = i;
+        blocks.back().cost += Instruction::getExecutionTime(program[i].opcode);
+        blockOf[i] = blocks.size() - 1;
+    }
+
+    for (auto &block : blocks) {
+        size_t last = block.last;
+        Opcode opcode = program[last].opcode;
+        auto addSuccessor = [&](long long index) {
+            if (inProgram(index))
+                block.successors.push_back(blockOf[index]);
+            else
+                block.terminal = true;
+        };
+
+        if (opcode == JUMP && isCall(last) && inProgram(target(last))) {
+            block.call = true;
+            block.callee = blockOf[target(last)];
+            addSuccessor(last + 1);
+        } else if (isJump(opcode)) {
+            addSuccessor(target(last));
+            if (opcode != JUMP) addSuccessor(last + 1);
+        } else if (opcode == RTRN || opcode == HALT) {
+            block.terminal = true;
+        } else {
+            addSuccessor(last + 1);
+        }
+    }
+}
+
+Cost CostAnalyzer::procedureCost(size_t entry) {
+    auto known = procedures.find(entry);
+    if (known != procedures.end()) return known->second;
+    if (inProgress.count(entry)) return Cost::unbounded();  // recursion
+
+    inProgress.insert(entry);
+    Cost cost = analyzeRegion(entry);
+    inProgress.erase(entry);
+    procedures[entry] = cost;
+    report.procedures.push_back({blocks[entry].first, cost});
+    return cost;
+}
+
+void CostAnalyzer::computeDominators(Region &region, size_t entry) const {
+    size_t n = blocks.size();
+
+    // reverse postorder of the blocks reachable from the entry
+    std::vector<size_t> postorder;
+    std::vector<bool> visited(n, false);
+    std::vector<std::pair<size_t, size_t>> stack = {{entry, 0}};
+    visited[entry] = true;
+    while (!stack.empty()) {
+        auto &[block, next] = stack.back();
+        if (next < blocks[block].successors.size()) {
+            size_t successor = blocks[block].successors[next++];
+            if (!visited[successor]) {
+                visited[successor] = true;
+                stack.push_back({successor, 0});
+            }
+        } else {
+            postorder.push_back(block);
+            stack.pop_back();
+        }
+    }
+    region.order.assign(postorder.rbegin(), postorder.rend());
+    region.position.assign(n, NONE);
+    for (size_t k = 0; k < region.order.size(); k++)
+        region.position[region.order[k]] = k;
+
+    std::vector<std::vector<size_t>> predecessors(n);
+    for (size_t block : region.order)
+        for (size_t successor : blocks[block].successors)
+            predecessors[successor].push_back(block);
+
+    // Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+    region.idom.assign(n, NONE);
+    region.idom[entry] = entry;
+    auto intersect = [&region](size_t a, size_t b) {
+        while (a != b) {
+            while (region.position[a] > region.position[b]) a = region.idom[a];
+            while (region.position[b] > region.position[a]) b = region.idom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t block : region.order) {
+            if (block == entry) continue;
+            size_t idom = NONE;
+            for (size_t predecessor : predecessors[block]) {
+                if (region.idom[predecessor] == NONE) continue;
+                idom = idom == NONE ? predecessor : intersect(predecessor, idom);
+            }
+            if (idom != region.idom[block]) {
+                region.idom[block] = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool CostAnalyzer::dominates(const Region &region, size_t a, size_t b) const {
+    if (region.position[a] == NONE || region.position[b] == NONE) return false;
+    while (b != a && region.idom[b] != b) b = region.idom[b];
+    return a == b;
+}
+
+size_t CostAnalyzer::find(const Region &region, size_t block) const {
+    while (region.rep[block] != block) block = region.rep[block];
+    return block;
+}
+
+Cost CostAnalyzer::analyzeRegion(size_t entry) {
+    Region region;
+    computeDominators(region, entry);
+
+    size_t n = blocks.size();
+    region.rep.resize(n);
+    std::iota(region.rep.begin(), region.rep.end(), 0);
+    region.cost.resize(n);
+    region.successors.resize(n);
+    region.terminal.assign(n, false);
+
+    std::map<size_t, std::vector<size_t>> latches;  // loop header -> latches
+    for (size_t block : region.order) {
+        region.cost[block] = Cost(blocks[block].cost);
+        if (blocks[block].call)
+            region.cost[block] += procedureCost(blocks[block].callee);
+        region.terminal[block] = blocks[block].terminal;
+        for (size_t successor : blocks[block].successors) {
+            if (region.position[successor] > region.position[block]) {
+                region.successors[block].push_back(successor);
+            } else if (dominates(region, successor, block)) {
+                region.successors[block].push_back(successor);
+                latches[successor].push_back(block);
+            } else {
+                region.irreducible = true;  // retreating edge into a loop body
+            }
+        }
+    }
+
+    std::vector<std::vector<size_t>> predecessors(n);
+    for (size_t block : region.order)
+        for (size_t successor : region.successors[block])
+            predecessors[successor].push_back(block);
+
+    // natural loops, innermost (smallest) first
+    std::vector<std::pair<size_t, std::set<size_t>>> loops;
+    for (auto &[header, ends] : latches) {
+        std::set<size_t> body = {header};
+        std::vector<size_t> work(ends.begin(), ends.end());
+        while (!work.empty()) {
+            size_t block = work.back();
+            work.pop_back();
+            if (!body.insert(block).second) continue;
+            for (size_t predecessor : predecessors[block])
+                if (!body.count(predecessor)) work.push_back(predecessor);
+        }
+        loops.emplace_back(header, body);
+    }
+    std::sort(loops.begin(), loops.end(), [](const auto &a, const auto &b) {
+        return a.second.size() < b.second.size();
+    });
+    for (auto &[header, body] : loops)
+        report.loops.push_back(collapseLoop(region, header, body));
+
+    std::set<size_t> members;
+    for (size_t block : region.order) members.insert(find(region, block));
+    PathCosts paths = pathCosts(region, find(region, entry), members);
+    Cost total = paths.toExit;
+    if (paths.cyclic || region.irreducible) total += Cost::unbounded();
+    return total;
+}
+
+CostAnalyzer::PathCosts CostAnalyzer::pathCosts(
+    const Region &region, size_t start, const std::set<size_t> &members) const {
+    // nodes reachable from start without passing through it again
+    std::set<size_t> reachable = {start};
+    std::vector<size_t> work = {start};
+    std::map<size_t, int> incoming;
+    while (!work.empty()) {
+        size_t node = work.back();
+        work.pop_back();
+        for (size_t successor : region.successors[node]) {
+            size_t next = find(region, successor);
+            if (next == start || !members.count(next)) continue;
+            incoming[next]++;
+            if (reachable.insert(next).second) work.push_back(next);
+        }
+    }
+
+    // longest/shortest path costs in topological order
+    std::map<size_t, Cost> in = {{start, Cost()}};
+    std::optional<Cost> toStart, toExit;
+    size_t processed = 0;
+    work = {start};
+    while (!work.empty()) {
+        size_t node = work.back();
+        work.pop_back();
+        processed++;
+        Cost out = in[node];
+        out += region.cost[node];
+        if (region.terminal[node]) widen(toExit, out);
+        for (size_t successor : region.successors[node]) {
+            size_t next = find(region, successor);
+            if (next == start) {
+                widen(toStart, out);
+            } else if (!members.count(next)) {
+                widen(toExit, out);
+            } else {
+                auto it = in.find(next);
+                if (it == in.end())
+                    in.emplace(next, out);
+                else
+                    it->second = it->second.hull(out);
+                if (--incoming[next] == 0) work.push_back(next);
+            }
+        }
+    }
+
+    PathCosts paths;
+    paths.toStart = toStart.value_or(Cost());
+    paths.toExit = toExit ? *toExit : Cost::unbounded();
+    paths.cyclic = processed < reachable.size();
+    return paths;
+}
+
+LoopReport CostAnalyzer::collapseLoop(Region &region, size_t header,
+                                      const std::set<size_t> &body) {
+    std::set<size_t> members;
+    for (size_t block : body) members.insert(find(region, block));
+    PathCosts paths = pathCosts(region, header, members);
+
+    LoopReport loop;
+    loop.symbol = report.loops.size() + 1;
+    loop.first = blocks[*body.begin()].first;
+    loop.last = blocks[*body.rbegin()].last;
+    loop.iteration = paths.toStart;
+    classifyLoop(region, header, body, loop);
+
+    loop.total = paths.toExit;
+    if (loop.tripCountKnown)
+        loop.total += loop.iteration.times(loop.tripCount);
+    else
+        loop.total += loop.iteration.timesSymbol(loop.symbol);
+    if (paths.cyclic) loop.total += Cost::unbounded();
+
+    // the loop becomes a single node leaving to its exits
+    std::vector<size_t> exits;
+    bool terminal = false;
+    for (size_t node : members) {
+        terminal = terminal || region.terminal[node];
+        for (size_t successor : region.successors[node])
+            if (!members.count(find(region, successor)))
+                exits.push_back(successor);
+        if (node != header) region.rep[node] = header;
+    }
+    region.cost[header] = loop.total;
+    region.successors[header] = exits;
+    region.terminal[header] = terminal;
+    return loop;
+}
+
+// FOR loops as emitted by the code generator:
+//   LOAD from; STORE i;        preheader
+//   LOAD i; SUB to; JPOS end   header (JNEG for DOWNTO)
+//   ...                        body
+//   SET 1; ADD i; STORE i; JUMP header
+//   (DOWNTO: SET 1; STORE t; LOAD i; SUB t; STORE i; JUMP header)
+// or, from the IR lowering and the for-step peephole rules, with one a
+// cell holding the constant 1:
+//   LOAD i; ADD one; STORE i; JUMP header   (DOWNTO: SUB one)
+void CostAnalyzer::classifyLoop(const Region &region, size_t header,
+                                const std::set<size_t> &body,
+                                LoopReport &loop) const {
+    loop.forLoop = false;
+    loop.tripCountKnown = false;
+    loop.tripCount = 0;
+
+    const Block &head = blocks[header];
+    if (head.last - head.first != 2 || head.first < 2) return;
+    const ProgramInstruction &load = program[head.first];
+    const ProgramInstruction &compare = program[head.first + 1];
+    Opcode exitJump = program[head.last].opcode;
+    bool up = exitJump == JPOS;
+    long long iterator = load.operand;
+    if (load.opcode != LOAD || (compare.opcode != SUB && compare.opcode != SUBI) ||
+        (exitJump != JPOS && exitJump != JNEG))
+        return;
+
+    const ProgramInstruction &from = program[head.first - 2];
+    if ((from.opcode != LOAD && from.opcode != LOADI) ||
+        program[head.first - 1].opcode != STORE ||
+        program[head.first - 1].operand != iterator)
+        return;
+
+    std::vector<size_t> latchBlocks;
+    for (size_t block : body)
+        for (size_t successor : blocks[block].successors)
+            if (successor == header) latchBlocks.push_back(block);
+    if (latchBlocks.size() != 1) return;
+
+    size_t jump = blocks[latchBlocks[0]].last;
+    auto is = [this](size_t index, Opcode opcode, long long operand) {
+        return program[index].opcode == opcode && program[index].operand == operand;
+    };
+    if (program[jump].opcode != JUMP ||
+        target(jump) != static_cast<long long>(head.first))
+        return;
+    long long one;
+    bool stepByCell = jump >= 3 && is(jump - 3, LOAD, iterator) &&
+                      program[jump - 2].opcode == (up ? ADD : SUB) &&
+                      constantCell(region, program[jump - 2].operand, header,
+                                   one) &&
+                      one == 1;
+    if (stepByCell) {
+        if (!is(jump - 1, STORE, iterator)) return;
+    } else if (up) {
+        if (jump < 3 || !is(jump - 3, SET, 1) || !is(jump - 2, ADD, iterator) ||
+            !is(jump - 1, STORE, iterator))
+            return;
+    } else {
+        if (jump < 5 || !is(jump - 5, SET, 1) ||
+            program[jump - 4].opcode != STORE ||
+            !is(jump - 3, LOAD, iterator) ||
+            !is(jump - 2, SUB, program[jump - 4].operand) ||
+            !is(jump - 1, STORE, iterator))
+            return;
+    }
+
+    // the step must be the only write to the iterator inside the loop
+    if (addressTaken.count(iterator)) return;
+    for (size_t block : body)
+        for (size_t i = blocks[block].first; i <= blocks[block].last; i++)
+            if (is(i, STORE, iterator) && i != jump - 1) return;
+    loop.forLoop = true;
+
+    long long first, bound;
+    if (from.opcode != LOAD || compare.opcode != SUB ||
+        !constantCell(region, from.operand, header, first) ||
+        !constantCell(region, compare.operand, header, bound))
+        return;
+    __int128 trips = up ? (__int128)bound - first + 1 : (__int128)first - bound + 1;
+    loop.tripCountKnown = true;
+    loop.tripCount = trips < 0 ? 0 : trips > LLONG_MAX ? LLONG_MAX : (long long)trips;
+}
+
+// A cell holds a constant in the loop if its address is never taken and its
+// only write, in the program prologue or in a block dominating the loop
+// header, stores a constant.
+bool CostAnalyzer::constantCell(const Region &region, long long cell,
+                                size_t header, long long &value,
+                                int depth) const {
+    auto writes = stores.find(cell);
+    if (addressTaken.count(cell) || writes == stores.end() ||
+        writes->second.size() != 1)
+        return false;
+
+    size_t store = writes->second[0];
+    size_t block = blockOf[store];
+    if (store == 0 || blocks[block].first == store) return false;
+    if (block != 0 && !dominates(region, block, header)) return false;
+
+    // SET k; STORE cell, or a copy of another constant (p := 2 is
+    // LOAD <rvalue of 2>; STORE p)
+    const ProgramInstruction &source = program[store - 1];
+    if (source.opcode == SET) {
+        value = source.operand;
+        return true;
+    }
+    return source.opcode == LOAD && source.operand != cell && depth < 8 &&
+           constantCell(region, source.operand, header, value, depth + 1);
+}
+
+}  // namespace costan
@@ -0,0 +1,79 @@
+#include "Program.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "BinaryFormat.hpp"
+
+namespace costan {
+
+static Program readBinaryProgram(std::ifstream &in, const std::string &fileName) {
+    codegen::mrb::Header header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || header.version != codegen::mrb::VERSION)
+        throw std::runtime_error(fileName + ": unsupported .mrb header");
+
+    std::vector<codegen::mrb::Record> records(header.count);
+    in.read(reinterpret_cast<char *>(records.data()),
+            records.size() * sizeof(codegen::mrb::Record));
+    if (!in) throw std::runtime_error(fileName + ": truncated .mrb file");
+
+    Program program;
+    program.reserve(records.size());
+    for (auto &record : records) {
+        if (record.opcode >= UNDEFINED)
+            throw std::runtime_error(fileName + ": unknown opcode " +
+                                     std::to_string(record.opcode));
+        program.push_back({static_cast<Opcode>(record.opcode), record.operand});
+    }
+    return program;
+}
+
+static Program readTextProgram(std::ifstream &in, const std::string &fileName) {
+    static const std::map<std::string, Opcode> opcodes = {
+        {"GET", GET},     {"PUT", PUT},       {"LOAD", LOAD},   {"STORE", STORE},
+        {"LOADI", LOADI}, {"STOREI", STOREI}, {"ADD", ADD},     {"SUB", SUB},
+        {"ADDI", ADDI},   {"SUBI", SUBI},     {"SET", SET},     {"HALF", HALF},
+        {"JUMP", JUMP},   {"JPOS", JPOS},     {"JZERO", JZERO}, {"JNEG", JNEG},
+        {"RTRN", RTRN},   {"HALT", HALT}};
+
+    Program program;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name)) continue;
+
+        auto opcode = opcodes.find(name);
+        if (opcode == opcodes.end())
+            throw std::runtime_error(fileName + ":" + std::to_string(lineNumber) +
+                                     ": unknown instruction " + name);
+        long long operand = 0;
+        bool hasOperand = opcode->second != HALF && opcode->second != HALT;
+        if (hasOperand && !(fields >> operand))
+            throw std::runtime_error(fileName + ":" + std::to_string(lineNumber) +
+                                     ": missing operand");
+        program.push_back({opcode->second, operand});
+    }
+    return program;
+}
+
+Program readProgram(const std::string &fileName) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("Could not open file " + fileName);
+
+    char magic[sizeof(codegen::mrb::MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    bool binary = in.gcount() == sizeof(magic) &&
+                  std::equal(std::begin(magic), std::end(magic),
+                             std::begin(codegen::mrb::MAGIC));
+    in.clear();
+    in.seekg(0);
+    return binary ? readBinaryProgram(in, fileName) : readTextProgram(in, fileName);
+}
+
+}  // namespace costan
@@ -0,0 +1,181 @@
+#include "IR.hpp"
+
+namespace ir {
+
+Operand Operand::cell(long long address) {
+    return {OperandKind::CELL, false, address};
+}
+
+Operand Operand::temp(int number) { return {OperandKind::TEMP, false, number}; }
+
+Operand Operand::constant(long long value) {
+    return {OperandKind::CONST, false, value};
+}
+
+Operand Operand::address(long long address) {
+    return {OperandKind::ADDR, false, address};
+}
+
+Operand Operand::deref() const {
+    Operand operand = *this;
+    operand.indirect = true;
+    return operand;
+}
+
+bool Operand::operator==(const Operand &other) const {
+    return kind == other.kind && indirect == other.indirect &&
+           value == other.value;
+}
+
+std::vector<int> BasicBlock::successors() const {
+    switch (exit.exit) {
+        case Exit::JUMP:
+            return {exit.target};
+        case Exit::BRANCH:
+            return {exit.target, exit.otherwise};
+        default:
+            return {};
+    }
+}
+
+std::ostream &operator<<(std::ostream &os, Relation relation) {
+    static const char *const symbols[] = {"=", "!=", "<", "<=", ">", ">="};
+    return os << symbols[static_cast<int>(relation)];
+}
+
+static void printCell(std::ostream &os, const Module &module,
+                      long long address) {
+    auto it = module.names.find(address);
+    if (it != module.names.end())
+        os << it->second;
+    else
+        os << '[' << address << ']';
+}
+
+static void printOperand(std::ostream &os, const Module &module,
+                         const Operand &operand) {
+    if (operand.indirect) os << '*';
+    switch (operand.kind) {
+        case OperandKind::CELL:
+            printCell(os, module, operand.value);
+            break;
+        case OperandKind::TEMP:
+            os << "%t" << operand.value;
+            break;
+        case OperandKind::CONST:
+            os << operand.value;
+            break;
+        case OperandKind::ADDR:
+            os << '&';
+            printCell(os, module, operand.value);
+            break;
+        case OperandKind::NONE:
+            os << '_';
+            break;
+    }
+}
+
+static void printOrigin(std::ostream &os, int line, const char *kind) {
+    os << "    ; " << kind;
+    if (line) os << " @" << line;
+    os << '\n';
+}
+
+static void printInstr(std::ostream &os, const Module &module,
+                       const Instr &instr) {
+    static const char *const operators[] = {"", "+", "-", "*", "/", "%"};
+    os << "    ";
+    switch (instr.op) {
+        case Op::COPY:
+            printOperand(os, module, instr.dst);
+            os << " = ";
+            printOperand(os, module, instr.a);
+            break;
+        case Op::ADD:
+        case Op::SUB:
+        case Op::MUL:
+        case Op::DIV:
+        case Op::MOD:
+            printOperand(os, module, instr.dst);
+            os << " = ";
+            printOperand(os, module, instr.a);
+            os << ' ' << operators[static_cast<int>(instr.op)] << ' ';
+            printOperand(os, module, instr.b);
+            break;
+        case Op::READ:
+            os << "read ";
+            printOperand(os, module, instr.dst);
+            break;
+        case Op::WRITE:
+            os << "write ";
+            printOperand(os, module, instr.a);
+            break;
+        case Op::CALL:
+            os << "call " << module.functions[instr.callee].name << '(';
+            for (size_t k = 0; k < instr.args.size(); k++) {
+                if (k) os << ", ";
+                printOperand(os, module, instr.args[k]);
+            }
+            os << ')';
+            break;
+    }
+    printOrigin(os, instr.line, instr.kind);
+}
+
+static void printExit(std::ostream &os, const Module &module,
+                      const Terminator &exit) {
+    os << "    ";
+    switch (exit.exit) {
+        case Exit::JUMP:
+            os << "goto B" << exit.target;
+            break;
+        case Exit::BRANCH:
+            os << "if ";
+            printOperand(os, module, exit.a);
+            os << ' ' << exit.relation << ' ';
+            printOperand(os, module, exit.b);
+            os << " goto B" << exit.target << " else B" << exit.otherwise;
+            break;
+        case Exit::RETURN:
+            os << "return";
+            break;
+        case Exit::HALT:
+            os << "halt";
+            break;
+    }
+    printOrigin(os, exit.line, exit.kind);
+}
+
+static void printFunction(std::ostream &os, const Module &module,
+                          const Function &function) {
+    if (function.returnCell) {
+        os << "procedure " << function.name << '(';
+        for (size_t k = 0; k < function.paramNames.size(); k++) {
+            if (k) os << ", ";
+            os << function.paramNames[k];
+        }
+        os << ")\n";
+    } else {
+        os << "main\n";
+    }
+    for (auto &block : function.blocks) {
+        os << "  B" << block.id << ':';
+        auto successors = block.successors();
+        if (!successors.empty()) {
+            os << "  ->";
+            for (int successor : successors) os << " B" << successor;
+        }
+        os << '\n';
+        for (auto &instr : block.code) printInstr(os, module, instr);
+        printExit(os, module, block.exit);
+    }
+}
+
+void print(std::ostream &os, const Module &module) {
+    for (size_t k = 0; k < module.functions.size(); k++) {
+        if (k) os << '\n';
+        printFunction(os, module, module.functions[k]);
+    }
+}
+
+}  // namespace ir
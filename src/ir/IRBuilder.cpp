@@ -0,0 +1,429 @@
+#include "IRBuilder.hpp"
+
+#include <stdexcept>
+
+#include "ASTNodeFactory.hpp"
+#include "CommandsNode.hpp"
+#include "ConditionNode.hpp"
+#include "ExpressionNode.hpp"
+#include "IdentifierNode.hpp"
+#include "MainNode.hpp"
+#include "ProceduresNode.hpp"
+#include "ProgramAllNode.hpp"
+#include "ValueNode.hpp"
+
+namespace ir {
+
+IRBuilder::IRBuilder(compiler::Context &context) : context(context) {}
+
+Module IRBuilder::build() {
+    auto program =
+        ast::ASTNodeFactory::castNode<ast::ProgramAllNode>(context.astRoot);
+    for (auto &procedure : program->procedures) buildProcedure(procedure);
+    buildMain(program->main);
+    return std::move(module);
+}
+
+void IRBuilder::buildProcedure(ASTNode *node) {
+    auto procedure = ast::ASTNodeFactory::castNode<ast::ProceduresNode>(node);
+    auto head =
+        ast::ASTNodeFactory::castNode<ast::ProcHeadNode>(procedure->proc_head);
+
+    Function procedureFunction;
+    procedureFunction.name = head->pidentifier;
+    procedureFunction.line = node->getPosition().line;
+    procedureFunction.returnCell =
+        context.symbolTable.getProcedureAddr(head->pidentifier);
+    auto args =
+        ast::ASTNodeFactory::castNode<ast::ArgsDeclNode>(head->args_decl);
+    for (int n = 1; n <= static_cast<int>(args->argsOrders.size()); n++) {
+        procedureFunction.params.push_back(
+            context.symbolTable.getAddrOfProcArg(head->pidentifier, n));
+        procedureFunction.paramNames.push_back(args->argsOrders.at(n));
+    }
+    functionIndex[head->pidentifier] = module.functions.size();
+    module.functions.push_back(std::move(procedureFunction));
+
+    procName = head->pidentifier;
+    beginFunction(module.functions.back());
+    beginStatement(function->line, "procedure");
+    buildCommands(procedure->commands);
+    setKind("return");
+    setExit({Exit::RETURN});
+    endStatement();
+    endFunction();
+}
+
+void IRBuilder::buildMain(ASTNode *node) {
+    auto main = ast::ASTNodeFactory::castNode<ast::MainNode>(node);
+
+    Function mainFunction;
+    mainFunction.name = "main";
+    mainFunction.line = node->getPosition().line;
+    module.functions.push_back(std::move(mainFunction));
+
+    procName = "main";
+    beginFunction(module.functions.back());
+    beginStatement(function->line, "main");
+    buildCommands(main->commands);
+    endStatement();
+    beginStatement(context.astRoot->getPosition().line, "halt");
+    setExit({Exit::HALT});
+    endStatement();
+    endFunction();
+}
+
+void IRBuilder::beginFunction(Function &function) {
+    this->function = &function;
+    function.firstTemp = module.temps;
+    freeTemps.clear();
+    layout.clear();
+    startBlock(newBlock());
+}
+
+// Blocks are numbered in the order they were started, which puts the code
+// of every statement between the blocks around it.
+void IRBuilder::endFunction() {
+    std::vector<int> position(function->blocks.size(), -1);
+    for (size_t k = 0; k < layout.size(); k++) position[layout[k]] = k;
+
+    std::vector<BasicBlock> blocks;
+    blocks.reserve(layout.size());
+    for (int id : layout) {
+        BasicBlock block = std::move(function->blocks[id]);
+        block.id = position[id];
+        if (block.exit.target >= 0)
+            block.exit.target = position[block.exit.target];
+        if (block.exit.otherwise >= 0)
+            block.exit.otherwise = position[block.exit.otherwise];
+        blocks.push_back(std::move(block));
+    }
+    function->blocks = std::move(blocks);
+    module.temps += function->temps;
+    function = nullptr;
+}
+
+void IRBuilder::buildCommands(ASTNode *node) {
+    auto commands = ast::ASTNodeFactory::castNode<ast::CommandsNode>(node);
+    for (auto &command : commands->commands) buildCommand(command);
+}
+
+void IRBuilder::buildCommand(ASTNode *node) {
+    int line = node->getPosition().line;
+    switch (node->getNodeType()) {
+        case ASSIGNMENT_NODE: {
+            beginStatement(line, "assign");
+            auto assignment =
+                ast::ASTNodeFactory::castNode<ast::AssignmentNode>(node);
+            auto expression =
+                ast::ASTNodeFactory::castNode<ast::ExpressionNode>(
+                    assignment->expression);
+            Instr instr = {Op::COPY};
+            instr.dst = identifier(assignment->identifier);
+            instr.a = value(expression->value1);
+            if (expression->value2.has_value()) {
+                instr.b = value(expression->value2.value());
+                switch (expression->mathOperation.value()) {
+                    case ast::PLUS:
+                        instr.op = Op::ADD;
+                        break;
+                    case ast::SUBSTRACT:
+                        instr.op = Op::SUB;
+                        break;
+                    case ast::MULTIPLY:
+                        instr.op = Op::MUL;
+                        setKind("multiply");
+                        break;
+                    case ast::DIVIDE:
+                        instr.op = Op::DIV;
+                        setKind("divide");
+                        break;
+                    case ast::MOD:
+                        instr.op = Op::MOD;
+                        setKind("modulo");
+                        break;
+                }
+            }
+            emit(instr);
+            break;
+        }
+        case IF_STATEMENT_NODE: {
+            beginStatement(line, "if_condition");
+            auto ifStatement =
+                ast::ASTNodeFactory::castNode<ast::IfStatementNode>(node);
+            int thenBlock = newBlock();
+            int join = newBlock();
+            bool hasElse = ifStatement->elseCommands.has_value();
+            int elseBlock = hasElse ? newBlock() : join;
+            branch(ifStatement->condition, thenBlock, elseBlock);
+            startBlock(thenBlock);
+            buildCommands(ifStatement->commands);
+            if (hasElse) {
+                setKind("else_jump");
+                jumpTo(join);
+                startBlock(elseBlock);
+                buildCommands(ifStatement->elseCommands.value());
+            }
+            jumpTo(join);
+            startBlock(join);
+            break;
+        }
+        case WHILE_STATEMENT_NODE: {
+            beginStatement(line, "while_condition");
+            auto whileStatement =
+                ast::ASTNodeFactory::castNode<ast::WhileStatementNode>(node);
+            int header = newBlock();
+            int body = newBlock();
+            int exit = newBlock();
+            jumpTo(header);
+            startBlock(header);
+            branch(whileStatement->condition, body, exit);
+            startBlock(body);
+            loopDepth++;
+            buildCommands(whileStatement->commands);
+            loopDepth--;
+            setKind("while_jump");
+            jumpTo(header);
+            startBlock(exit);
+            break;
+        }
+        case REPEAT_STATEMENT_NODE: {
+            beginStatement(line, "repeat_condition");
+            auto repeatStatement =
+                ast::ASTNodeFactory::castNode<ast::RepeatStatementNode>(node);
+            int body = newBlock();
+            int exit = newBlock();
+            jumpTo(body);
+            startBlock(body);
+            loopDepth++;
+            buildCommands(repeatStatement->commands);
+            loopDepth--;
+            branch(repeatStatement->condition, exit, body);
+            startBlock(exit);
+            break;
+        }
+        case FOR_TO_NODE: {
+            beginStatement(line, "for_header");
+            auto forTo = ast::ASTNodeFactory::castNode<ast::ForToNode>(node);
+            buildFor(forTo->pidentifier, forTo->valueFrom, forTo->valueTo,
+                     forTo->commands, false);
+            break;
+        }
+        case FOR_DOWNTO_NODE: {
+            beginStatement(line, "for_header");
+            auto forDownto =
+                ast::ASTNodeFactory::castNode<ast::ForDowntoNode>(node);
+            buildFor(forDownto->pidentifier, forDownto->valueFrom,
+                     forDownto->valueTo, forDownto->commands, true);
+            break;
+        }
+        case PROC_CALL_NODE: {
+            beginStatement(line, "call");
+            auto call = ast::ASTNodeFactory::castNode<ast::ProcCallNode>(node);
+            auto args = ast::ASTNodeFactory::castNode<ast::ArgsNode>(call->args);
+            Instr instr = {Op::CALL};
+            instr.callee = functionIndex.at(call->pidentifier);
+            auto currentScope = scope();
+            for (auto &arg : args->pidentifiers) {
+                auto address = static_cast<long long>(
+                    context.symbolTable.getSymbolByName(arg, currentScope)
+                        .address);
+                module.names.emplace(address, arg);
+                // arguments of the caller already hold an address
+                instr.args.push_back(isArgument(arg)
+                                         ? Operand::cell(address)
+                                         : Operand::address(address));
+            }
+            emit(instr);
+            break;
+        }
+        case READ_NODE: {
+            beginStatement(line, "read");
+            auto read = ast::ASTNodeFactory::castNode<ast::ReadNode>(node);
+            Instr instr = {Op::READ};
+            instr.dst = identifier(read->identifier);
+            emit(instr);
+            break;
+        }
+        case WRITE_NODE: {
+            beginStatement(line, "write");
+            auto write = ast::ASTNodeFactory::castNode<ast::WriteNode>(node);
+            Instr instr = {Op::WRITE};
+            instr.a = value(write->value);
+            emit(instr);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown command node");
+    }
+    endStatement();
+}
+
+// FOR i FROM a TO b: i = a and the bound is evaluated once, then the header
+// leaves the loop when i > b (i < b for DOWNTO) and the step block moves i.
+void IRBuilder::buildFor(std::string &iterator, ASTNode *from, ASTNode *to,
+                         ASTNode *commands, bool downto) {
+    Operand counter = variable(iterator);
+    Instr init = {Op::COPY};
+    init.dst = counter;
+    init.a = value(from);
+    emit(init);
+
+    Operand bound = value(to);
+    if (bound.kind != OperandKind::CONST) {
+        Instr copy = {Op::COPY};
+        copy.dst = Operand::temp(newTemp());
+        copy.a = bound;
+        emit(copy);
+        bound = copy.dst;
+    }
+
+    int header = newBlock();
+    int body = newBlock();
+    int exit = newBlock();
+    jumpTo(header);
+    startBlock(header);
+    Terminator test = {Exit::BRANCH, downto ? Relation::LT : Relation::GT,
+                       counter, bound, exit, body};
+    setExit(test);
+
+    startBlock(body);
+    loopDepth++;
+    buildCommands(commands);
+    loopDepth--;
+    setKind("for_step");
+    Instr step = {downto ? Op::SUB : Op::ADD, counter, counter,
+                  Operand::constant(1)};
+    emit(step);
+    jumpTo(header);
+    startBlock(exit);
+}
+
+void IRBuilder::branch(ASTNode *node, int target, int otherwise) {
+    auto condition = ast::ASTNodeFactory::castNode<ast::ConditionNode>(node);
+    Terminator exit = {Exit::BRANCH};
+    exit.relation = static_cast<Relation>(condition->relation);
+    exit.a = value(condition->value1);
+    exit.b = value(condition->value2);
+    exit.target = target;
+    exit.otherwise = otherwise;
+    setExit(exit);
+}
+
+Operand IRBuilder::value(ASTNode *node) {
+    auto valueNode = ast::ASTNodeFactory::castNode<ast::ValueNode>(node);
+    if (valueNode->num.has_value())
+        return Operand::constant(std::stoll(valueNode->num.value()));
+    return identifier(valueNode->identifier.value());
+}
+
+// Array elements are reached through a temporary holding their address,
+// unless the array is local and the index a constant.
+Operand IRBuilder::identifier(ASTNode *node) {
+    auto identifierNode =
+        ast::ASTNodeFactory::castNode<ast::IdentifierNode>(node);
+    if (identifierNode->pidentifier.has_value())
+        return variable(identifierNode->pidentifier.value());
+
+    auto name = identifierNode->Tpidentifier.value();
+    auto currentScope = scope();
+    auto base = static_cast<long long>(
+        context.symbolTable.getSymbolByName(name, currentScope).address);
+    Operand index =
+        identifierNode->arrayNumIndex.has_value()
+            ? Operand::constant(
+                  std::stoll(identifierNode->arrayNumIndex.value()))
+            : variable(identifierNode->arrayPidentifierIndex.value());
+
+    Instr address = {Op::ADD};
+    if (isArgument(name)) {
+        module.names.emplace(base, name);
+        address.a = Operand::cell(base);  // holds the address of name[0]
+    } else if (index.kind == OperandKind::CONST) {
+        module.names.emplace(base + index.value,
+                             name + "[" + std::to_string(index.value) + "]");
+        return Operand::cell(base + index.value);
+    } else {
+        module.names.emplace(base, name);
+        address.a = Operand::address(base);
+    }
+    address.dst = Operand::temp(newTemp());
+    address.b = index;
+    emit(address);
+    return address.dst.deref();
+}
+
+// Scalar arguments of procedures hold the address of the variable passed.
+Operand IRBuilder::variable(std::string name) {
+    auto currentScope = scope();
+    auto address = static_cast<long long>(
+        context.symbolTable.getSymbolByName(name, currentScope).address);
+    module.names.emplace(address, name);
+    Operand operand = Operand::cell(address);
+    return isArgument(name) ? operand.deref() : operand;
+}
+
+void IRBuilder::emit(Instr instr) {
+    instr.line = origins.back().first;
+    instr.kind = origins.back().second;
+    instr.loopDepth = loopDepth;
+    function->blocks[current].code.push_back(std::move(instr));
+}
+
+void IRBuilder::setExit(Terminator exit) {
+    exit.line = origins.back().first;
+    exit.kind = origins.back().second;
+    function->blocks[current].exit = exit;
+}
+
+int IRBuilder::newBlock() {
+    int id = function->blocks.size();
+    function->blocks.push_back({id});
+    return id;
+}
+
+void IRBuilder::startBlock(int block) {
+    current = block;
+    layout.push_back(block);
+}
+
+void IRBuilder::jumpTo(int block) {
+    Terminator exit = {Exit::JUMP};
+    exit.target = block;
+    setExit(exit);
+}
+
+int IRBuilder::newTemp() {
+    int temp;
+    if (!freeTemps.empty()) {
+        temp = freeTemps.back();
+        freeTemps.pop_back();
+    } else {
+        temp = function->firstTemp + function->temps++;
+    }
+    statementTemps.back().push_back(temp);
+    return temp;
+}
+
+void IRBuilder::beginStatement(int line, const char *kind) {
+    origins.emplace_back(line, kind);
+    statementTemps.emplace_back();
+}
+
+void IRBuilder::endStatement() {
+    for (int temp : statementTemps.back()) freeTemps.push_back(temp);
+    statementTemps.pop_back();
+    origins.pop_back();
+}
+
+void IRBuilder::setKind(const char *kind) { origins.back().second = kind; }
+
+bool IRBuilder::isArgument(std::string name) {
+    return context.symbolTable.isProcArgument(name, procName);
+}
+
+int IRBuilder::scope() {
+    return context.symbolTable.getScopeByProcName(procName);
+}
+
+}  // namespace ir
@@ -0,0 +1,341 @@
+#include "IRLowering.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "InstructNodes.hpp"
+
+namespace ir {
+
+IRLowering::IRLowering(const Module &module, unsigned long firstFreeAddress,
+                       long inlineLimit)
+    : module(module),
+      firstFreeAddress(firstFreeAddress),
+      firstTempAddress(0),
+      runtime(inlineLimit),
+      origin{0, "other"} {}
+
+LoweredCode IRLowering::lower() {
+    collectConstants();
+    firstTempAddress = firstFreeAddress + constants.size();
+    memory = codegen::Memory(firstTempAddress + module.temps - 1);
+    planRuntimeCalls();
+
+    origin = {0, "constants"};
+    for (auto &[value, cell] : constants) {
+        emit(SET, value);
+        emit(STORE, cell);
+    }
+
+    blockStart.resize(module.functions.size());
+    lowerFunction(module.functions.size() - 1);  // main
+    for (size_t k = 0; k + 1 < module.functions.size(); k++) lowerFunction(k);
+
+    origin = {0, "runtime"};
+    for (auto &i : runtime.place(code.instructions.size())) {
+        code.instructions.push_back(i);
+        code.sourceMap.push_back(origin);
+    }
+    for (auto &jump : runtimeJumps) {
+        code.instructions[jump.instruction].value =
+            runtime.start(jump.operation) -
+            static_cast<long>(jump.instruction);
+    }
+
+    for (auto &fixup : fixups) {
+        auto &function = module.functions[fixup.function];
+        int block = follow(function, fixup.block < 0 ? 0 : fixup.block);
+        long target = blockStart[fixup.function][block];
+        code.instructions[fixup.instruction].value =
+            target - static_cast<long>(fixup.instruction);
+    }
+    return std::move(code);
+}
+
+// Every constant operand is read from a cell. Addresses only need one when
+// they are added to something.
+void IRLowering::collectConstants() {
+    auto add = [this](const Operand &operand) {
+        if (operand.kind == OperandKind::CONST)
+            constants.emplace(operand.value, 0);
+    };
+    for (auto &function : module.functions) {
+        for (auto &block : function.blocks) {
+            for (auto &instr : block.code) {
+                add(instr.a);
+                add(instr.b);
+                if (instr.b.kind == OperandKind::ADDR)
+                    constants.emplace(instr.b.value, 0);
+            }
+            if (block.exit.exit == Exit::BRANCH) {
+                add(block.exit.a);
+                if (!(block.exit.b == Operand::constant(0))) add(block.exit.b);
+            }
+        }
+    }
+    unsigned long cell = firstFreeAddress;
+    for (auto &constant : constants) constant.second = cell++;
+}
+
+static codegen::AssignOperation kernelOperation(Op op) {
+    return op == Op::MUL   ? codegen::MULTIPLY
+           : op == Op::DIV ? codegen::DIVIDE
+                           : codegen::MOD;
+}
+
+// Multiplications and divisions the kernels compute (no constant factor or
+// divisor), each with the loops around it plus the deepest loop its
+// function is called from. Functions only call those before them, so going
+// from main backwards every caller is seen before its callees.
+void IRLowering::planRuntimeCalls() {
+    std::vector<int> callDepth(module.functions.size(), 0);
+    std::vector<codegen::ArithmeticSite> sites;
+    std::vector<const Instr *> instrs;
+    for (size_t f = module.functions.size(); f-- > 0;) {
+        for (auto &block : module.functions[f].blocks) {
+            for (auto &instr : block.code) {
+                int depth = callDepth[f] + instr.loopDepth;
+                if (instr.op == Op::CALL)
+                    callDepth[instr.callee] =
+                        std::max(callDepth[instr.callee], depth);
+                if (instr.op != Op::MUL && instr.op != Op::DIV &&
+                    instr.op != Op::MOD)
+                    continue;
+                if (instr.b.kind == OperandKind::CONST ||
+                    (instr.op == Op::MUL && instr.a.kind == OperandKind::CONST))
+                    continue;
+                sites.push_back({kernelOperation(instr.op), depth});
+                instrs.push_back(&instr);
+            }
+        }
+    }
+    auto calls = runtime.plan(sites, memory);
+    for (size_t k = 0; k < sites.size(); k++) {
+        if (calls[k]) runtimeCalls.insert(instrs[k]);
+    }
+}
+
+void IRLowering::lowerFunction(size_t index) {
+    auto &function = module.functions[index];
+    auto &starts = blockStart[index];
+    starts.assign(function.blocks.size(), -1);
+
+    std::vector<int> emitted;
+    for (auto &block : function.blocks) {
+        if (!isSkipped(function, block.id)) emitted.push_back(block.id);
+    }
+    for (size_t k = 0; k < emitted.size(); k++) {
+        auto &block = function.blocks[emitted[k]];
+        starts[block.id] = code.instructions.size();
+        for (auto &instr : block.code) lowerInstr(instr);
+        int next = k + 1 < emitted.size() ? emitted[k + 1] : -1;
+        lowerExit(index, block.exit, next);
+    }
+}
+
+void IRLowering::lowerInstr(const Instr &instr) {
+    origin = {instr.line, instr.kind};
+    switch (instr.op) {
+        case Op::COPY:
+            if (instr.dst == instr.a) break;
+            load(instr.a);
+            store(instr.dst);
+            break;
+        case Op::ADD:
+        case Op::SUB:
+            load(instr.a);
+            apply(instr.op == Op::ADD ? ADD : SUB, instr.b);
+            store(instr.dst);
+            break;
+        case Op::MUL:
+        case Op::DIV:
+        case Op::MOD:
+            lowerKernel(instr);
+            break;
+        case Op::READ:
+            if (instr.dst.indirect) {
+                emit(GET, 0);
+                emit(STOREI, cellOf(instr.dst));
+            } else {
+                emit(GET, cellOf(instr.dst));
+            }
+            break;
+        case Op::WRITE:
+            if (instr.a.indirect) {
+                emit(LOADI, cellOf(instr.a));
+                emit(PUT, 0);
+            } else {
+                emit(PUT, cellOf(instr.a));
+            }
+            break;
+        case Op::CALL:
+            lowerCall(instr);
+            break;
+    }
+}
+
+// Multiplication and division reuse the kernels of the code generator or
+// call their shared routines; only the loads of the operands and the store
+// of the result may go through a pointer.
+void IRLowering::lowerKernel(const Instr &instr) {
+    auto operation = kernelOperation(instr.op);
+    unsigned long result = cellOf(instr.dst);
+    unsigned long left = cellOf(instr.a);
+    unsigned long right = cellOf(instr.b);
+    std::vector<Instruction> kernel;
+    if (runtimeCalls.count(&instr)) {
+        kernel = runtime.call(operation, result, left, right,
+                              code.instructions.size());
+        runtimeJumps.push_back(
+            {code.instructions.size() + kernel.size() - 2, operation});
+    } else {
+        codegen::AssignNode node(memory);
+        node.waitForThirdArg = true;
+        node.operation = operation;
+        node.addVariable(result);
+        node.addVariable(left);
+        node.addVariable(right);
+        if (instr.a.kind == OperandKind::CONST) node.constant2 = instr.a.value;
+        if (instr.b.kind == OperandKind::CONST) node.constant3 = instr.b.value;
+        kernel = node.generateCode();
+    }
+
+    std::vector<unsigned long> pointers;
+    for (auto *operand : {&instr.dst, &instr.a, &instr.b}) {
+        if (operand->indirect) pointers.push_back(cellOf(*operand));
+    }
+    for (auto &i : kernel) {
+        if (i.mode == VALUE && !i.doNotModify &&
+            std::find(pointers.begin(), pointers.end(), i.value) !=
+                pointers.end()) {
+            i.opcode = i.opcode == LOAD ? LOADI : STOREI;
+        }
+        code.instructions.push_back(i);
+        code.sourceMap.push_back(origin);
+    }
+}
+
+// Arguments are passed as addresses in the cells of the parameters, the
+// return line in the return cell of the procedure.
+void IRLowering::lowerCall(const Instr &instr) {
+    auto &callee = module.functions[instr.callee];
+    for (size_t k = 0; k < instr.args.size(); k++) {
+        load(instr.args[k]);
+        emit(STORE, callee.params[k]);
+    }
+    code.instructions.push_back(
+        Instruction::line(SET, code.instructions.size() + 3));
+    code.sourceMap.push_back(origin);
+    emit(STORE, callee.returnCell);
+    jumpTo(JUMP, instr.callee, -1);
+}
+
+// a relation b is decided on a - b: either jump to the target when it
+// holds, or to the other block when it does not, whichever needs fewer
+// jumps given the block that follows.
+void IRLowering::lowerExit(size_t function, const Terminator &exit, int next) {
+    origin = {exit.line, exit.kind};
+    auto &current = module.functions[function];
+    switch (exit.exit) {
+        case Exit::JUMP:
+            if (follow(current, exit.target) != next)
+                jumpTo(JUMP, function, exit.target);
+            break;
+        case Exit::BRANCH: {
+            int target = follow(current, exit.target);
+            int otherwise = follow(current, exit.otherwise);
+            if (target == otherwise) {
+                if (target != next) jumpTo(JUMP, function, target);
+                break;
+            }
+            load(exit.a);
+            if (!(exit.b == Operand::constant(0))) apply(SUB, exit.b);
+
+            // jumps taken when the relation holds / does not hold
+            static const std::vector<Opcode> whenTrue[] = {
+                {JZERO}, {JPOS, JNEG}, {JNEG}, {JNEG, JZERO}, {JPOS}, {JPOS, JZERO}};
+            static const std::vector<Opcode> whenFalse[] = {
+                {JPOS, JNEG}, {JZERO}, {JPOS, JZERO}, {JPOS}, {JNEG, JZERO}, {JNEG}};
+            auto &onTrue = whenTrue[static_cast<int>(exit.relation)];
+            auto &onFalse = whenFalse[static_cast<int>(exit.relation)];
+
+            bool jumpOnTrue;
+            if (otherwise == next)
+                jumpOnTrue = true;
+            else if (target == next)
+                jumpOnTrue = false;
+            else
+                jumpOnTrue = onTrue.size() <= onFalse.size();
+
+            int taken = jumpOnTrue ? target : otherwise;
+            int rest = jumpOnTrue ? otherwise : target;
+            for (Opcode opcode : jumpOnTrue ? onTrue : onFalse)
+                jumpTo(opcode, function, taken);
+            if (rest != next) jumpTo(JUMP, function, rest);
+            break;
+        }
+        case Exit::RETURN:
+            emit(RTRN, current.returnCell);
+            break;
+        case Exit::HALT:
+            emit(HALT, 0);
+            break;
+    }
+}
+
+// End of the chain of blocks holding only a jump that starts at block.
+int IRLowering::follow(const Function &function, int block) const {
+    for (size_t hops = 0; hops < function.blocks.size(); hops++) {
+        if (!isSkipped(function, block)) return block;
+        block = function.blocks[block].exit.target;
+    }
+    return block;  // an empty endless loop
+}
+
+bool IRLowering::isSkipped(const Function &function, int block) const {
+    auto &basicBlock = function.blocks[block];
+    return basicBlock.code.empty() && basicBlock.exit.exit == Exit::JUMP &&
+           basicBlock.exit.target != block;
+}
+
+unsigned long IRLowering::cellOf(const Operand &operand) const {
+    switch (operand.kind) {
+        case OperandKind::CELL:
+            return operand.value;
+        case OperandKind::TEMP:
+            return firstTempAddress + operand.value;
+        case OperandKind::CONST:
+        case OperandKind::ADDR:
+            return constants.at(operand.value);
+        default:
+            throw std::runtime_error("Operand without a cell");
+    }
+}
+
+void IRLowering::load(const Operand &operand) {
+    if (operand.kind == OperandKind::ADDR)
+        emit(SET, operand.value);
+    else
+        emit(operand.indirect ? LOADI : LOAD, cellOf(operand));
+}
+
+void IRLowering::apply(Opcode opcode, const Operand &operand) {
+    if (operand.indirect) opcode = opcode == ADD ? ADDI : SUBI;
+    emit(opcode, cellOf(operand));
+}
+
+void IRLowering::store(const Operand &operand) {
+    emit(operand.indirect ? STOREI : STORE, cellOf(operand));
+}
+
+void IRLowering::jumpTo(Opcode opcode, size_t function, int block) {
+    fixups.push_back({code.instructions.size(), function, block});
+    emit(opcode, 0);
+}
+
+void IRLowering::emit(Opcode opcode, long value) {
+    code.instructions.emplace_back(opcode, value);
+    code.sourceMap.push_back(origin);
+}
+
+}  // namespace ir
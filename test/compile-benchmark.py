@@ -0,0 +1,68 @@
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+# Synthetic program with the given number of branches: every statement is an
+# IF (half of them with ELSE), nested in WHILE and FOR loops every 100 of them,
+# so jump labels of all kinds are generated.
+def generate_program(branches):
+    lines = ["PROGRAM IS", "  a, b, n, i", "BEGIN", "  READ a;", "  n:=0;"]
+    for k in range(branches):
+        if k % 100 == 0:
+            if k:
+                lines.append("  ENDFOR")
+                lines.append("  ENDWHILE")
+            lines.append(f"  WHILE n<{k + 1} DO")
+            lines.append("  n:=n+1;")
+            lines.append("  FOR i FROM 1 TO 2 DO")
+        if k % 2:
+            lines.append(f"    IF a={k} THEN b:=a+1; ELSE b:=a-1; ENDIF")
+        else:
+            lines.append(f"    IF a>{k} THEN WRITE a; ENDIF")
+    if branches:
+        lines.append("  ENDFOR")
+        lines.append("  ENDWHILE")
+    lines.append("  WRITE n;")
+    lines.append("END")
+    return "\n".join(lines) + "\n"
+
+
+def run_benchmark(compiler_path, branches):
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "branches.imp")
+        output = os.path.join(directory, "branches.mr")
+        with open(source, "w") as f:
+            f.write(generate_program(branches))
+
+        start = time.perf_counter()
+        result = subprocess.run(
+            [compiler_path, source, output],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.PIPE,
+            text=True,
+        )
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            print(f"Error while compiling {branches} branches: {result.stderr}")
+            return None
+
+        with open(output) as f:
+            instructions = sum(1 for _ in f)
+    return instructions, elapsed
+
+
+if __name__ == "__main__":
+    # usage: python3 ../test/compile-benchmark.py [compiler] [branches ...]
+    compiler_path = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "compiler")
+    sizes = [int(n) for n in sys.argv[2:]] or [1000, 10000, 100000]
+
+    print(f"{'branches':>10}{'instructions':>14}{'time [s]':>12}")
+    for branches in sizes:
+        result = run_benchmark(compiler_path, branches)
+        if result is None:
+            continue
+        instructions, elapsed = result
+        print(f"{branches:>10}{instructions:>14}{elapsed:>12.3f}")
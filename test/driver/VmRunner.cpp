@@ -0,0 +1,50 @@
+#include "VmRunner.hpp"
+
+#include <sstream>
+
+#include "machine.hh"
+
+namespace {
+
+// Reproduces what maszyna-wirtualna prints for GET/PUT, reading numbers
+// like cin does.
+class TranscriptIO : public MachineIO {
+   public:
+    explicit TranscriptIO(const std::string& input) : input(input) {}
+
+    long long read(long long v) override {
+        transcript += "? ";
+        input >> v;
+        return v;
+    }
+
+    void write(long long v) override {
+        transcript += "> " + std::to_string(v) + "\n";
+    }
+
+    std::string transcript;
+
+   private:
+    std::istringstream input;
+};
+
+}  // namespace
+
+VmRun runOnVm(const std::vector<std::pair<int, long long>>& program,
+              const std::string& input) {
+    TranscriptIO io(input);
+    DecodedProgram code;
+    decode_program(program, code);
+    MachineResult result = execute_machine(code, io);
+
+    VmRun run;
+    run.halted = result.status == MACHINE_HALT;
+    if (result.status == MACHINE_BAD_ADDRESS) {
+        run.error = "negative memory address";
+    } else if (result.status == MACHINE_BAD_JUMP) {
+        run.error = "jump to instruction " + std::to_string(result.lr);
+    }
+    run.transcript = std::move(io.transcript);
+    run.cost = result.cost;
+    return run;
+}
@@ -0,0 +1,20 @@
+#ifndef VM_RUNNER_HPP
+#define VM_RUNNER_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runs a program on the VM library. Kept in its own translation unit:
+// vm/instructions.hh and the compiler's Opcode declare the same names.
+struct VmRun {
+    bool halted;
+    std::string error;       // set when the program did not halt
+    std::string transcript;  // "? " per GET, "> value" line per PUT
+    long long cost;
+};
+
+VmRun runOnVm(const std::vector<std::pair<int, long long>>& program,
+              const std::string& input);
+
+#endif  // VM_RUNNER_HPP
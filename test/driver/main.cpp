@@ -0,0 +1,336 @@
+// In-process test driver: compiles every test/input program on a pool of
+// threads, runs the result on the VM library and diffs the transcript
+// against test/expected_vm_output. Same programs and inputs as
+// start_testing.sh + test-runner.py, without spawning a process per test.
+// Programs listed in exactCostPrograms are also costed by mr-cost's
+// analyzer, which must give their exact cost.
+
+#include <FlexLexer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BinaryFormat.hpp"
+#include "CompilerInterface.hpp"
+#include "CostAnalyzer.hpp"
+#include "ErrorMessages.hpp"
+#include "Parser.hpp"
+#include "ProgramAllNode.hpp"
+#include "VmRunner.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+extern ast::ProgramAllNode* astRoot;
+extern int line_number;
+extern int column_number;
+
+// The bison parser and the flex position counters are globals, so only one
+// thread parses at a time. Semantic analysis, code generation and the VM
+// run in parallel.
+static std::mutex parserMutex;
+static yyFlexLexer* currentLexer = nullptr;
+static bool viaIr = false;  // compile through the IR
+static bool constantFolding = true;
+
+int yylex() { return currentLexer->yylex(); }
+
+// Keep in sync with program_inputs in test-runner.py.
+static const std::map<std::string, std::string> programInputs = {
+    {"example1", "13\n3\n"},
+    {"example2", "0\n1\n"},
+    {"example3", "1\n"},
+    {"example4", "20\n9\n"},
+    {"example5", "1234567890\n1234567890987654321\n987654321\n"},
+    {"example6", "20\n"},
+    {"example7", "0\n0\n0\n"},
+    {"example8", ""},
+    {"example9", "20\n9\n"},
+    {"exampleA", ""},
+    {"program0", "124"},
+    {"program1", "30\n25\n20\n15\n"},
+    {"program2", ""},
+    {"program3", "12"},
+    {"test21", "7\n3\n0\n"},
+};
+
+// Discards everything; replaces cout/cerr while compilers chatter on many
+// threads.
+class NullBuffer : public std::streambuf {
+   protected:
+    int overflow(int c) override { return c; }
+};
+
+// FOR loops with constant bounds only: the static cost of the compiled
+// program has to be exact and equal to the cost of the run.
+static const std::set<std::string> exactCostPrograms = {"test23"};
+
+struct TestCase {
+    std::string name;
+    fs::path source;
+    bool expectError;
+    bool passed = false;
+    std::string message;
+    double compileMs = 0;
+    double runMs = 0;
+    long long cost = 0;
+};
+
+// Empty if mr-cost gives the program in file exactly the cost of its run.
+static std::string checkStaticCost(const fs::path& file, long long cost) {
+    costan::Program program = costan::readProgram(file.string());
+    costan::CostReport report = costan::CostAnalyzer(program).analyze();
+    if (!report.total.exact()) {
+        std::ostringstream message;
+        message << "mr-cost not exact: " << report.total;
+        return message.str();
+    }
+    long long estimate = report.total.constant().min;
+    if (estimate != cost) {
+        return "mr-cost " + std::to_string(estimate) + ", run " +
+               std::to_string(cost);
+    }
+    return "";
+}
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+static std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static bool loadProgram(const fs::path& file,
+                        std::vector<std::pair<int, long long>>& program) {
+    std::ifstream in(file, std::ios::binary);
+    codegen::mrb::Header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !std::equal(header.magic, header.magic + 4, codegen::mrb::MAGIC) ||
+        header.version != codegen::mrb::VERSION) {
+        return false;
+    }
+    std::vector<codegen::mrb::Record> records(header.count);
+    if (!in.read(reinterpret_cast<char*>(records.data()),
+                 records.size() * sizeof(codegen::mrb::Record))) {
+        return false;
+    }
+    program.clear();
+    for (const auto& record : records) {
+        program.emplace_back(record.opcode, record.operand);
+    }
+    return true;
+}
+
+static semana::ExitCode compileTest(TestCase& test, const fs::path& output) {
+    ast::ProgramAllNode* root = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(parserMutex);
+        std::ifstream file(test.source);
+        if (!file.is_open()) {
+            return semana::ExitCode::INTERNAL_ERROR;
+        }
+        yyFlexLexer lexer(&file, &std::cout);
+        currentLexer = &lexer;
+        line_number = 1;
+        column_number = 1;
+        astRoot = nullptr;
+        int parseResult = yyparse();
+        currentLexer = nullptr;
+        if (parseResult != 0 || astRoot == nullptr) {
+            return semana::ExitCode::SYNTAX_ERROR;
+        }
+        root = astRoot;
+    }
+
+    std::string inputFile = test.source.string();
+    std::string outputFile = output.string();
+    compiler::Compiler compiler;
+    compiler::Options options;
+    options.viaIr = viaIr;
+    options.constantFolding = constantFolding;
+    return compiler.compile(root, inputFile, outputFile, options);
+}
+
+static void runTest(TestCase& test, const fs::path& outputDir,
+                    const fs::path& expectedDir) {
+    fs::path output = outputDir / (test.name + ".imp.mrb");
+
+    auto start = Clock::now();
+    semana::ExitCode exitCode;
+    try {
+        exitCode = compileTest(test, output);
+    } catch (const std::exception&) {
+        exitCode = semana::ExitCode::INTERNAL_ERROR;
+    }
+    test.compileMs = millisecondsSince(start);
+
+    if (test.expectError) {
+        test.passed = exitCode != semana::ExitCode::SUCCESS;
+        test.message = test.passed ? "rejected" : "compiled, expected an error";
+        return;
+    }
+    if (exitCode != semana::ExitCode::SUCCESS) {
+        test.message = "compiler exit code " + std::to_string(exitCode);
+        return;
+    }
+
+    std::vector<std::pair<int, long long>> program;
+    if (!loadProgram(output, program)) {
+        test.message = "cannot read " + output.string();
+        return;
+    }
+
+    start = Clock::now();
+    auto input = programInputs.find(test.name);
+    VmRun run = runOnVm(
+        program, input != programInputs.end() ? input->second : "10\n");
+    test.runMs = millisecondsSince(start);
+    test.cost = run.cost;
+
+    if (!run.halted) {
+        test.message = run.error;
+        return;
+    }
+
+    std::ifstream expectedFile(expectedDir / (test.name + ".expected"));
+    if (!expectedFile.is_open()) {
+        test.message = "expected output file missing";
+        return;
+    }
+    std::stringstream expected;
+    expected << expectedFile.rdbuf();
+
+    // test-runner.py drops the VM's closing line together with whatever
+    // was printed on it, i.e. an unterminated "? " of a trailing GET.
+    std::string transcript = run.transcript;
+    transcript.erase(transcript.find_last_of('\n') + 1);
+
+    std::vector<std::string> actualLines = splitLines(transcript);
+    std::vector<std::string> expectedLines = splitLines(expected.str());
+    if (actualLines != expectedLines) {
+        auto mismatch = std::mismatch(actualLines.begin(), actualLines.end(),
+                                      expectedLines.begin(),
+                                      expectedLines.end());
+        size_t line = mismatch.first - actualLines.begin();
+        test.message = "output differs at line " + std::to_string(line + 1);
+        return;
+    }
+    if (exactCostPrograms.count(test.name)) {
+        test.message = checkStaticCost(output, run.cost);
+        if (!test.message.empty()) return;
+    }
+    test.passed = true;
+}
+
+int main(int argc, char** argv) {
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    int firstArg = 1;
+    while (argc - firstArg > 1) {
+        std::string option = argv[firstArg];
+        if (option == "-j" && argc - firstArg > 2) {
+            jobs = std::max(1, std::stoi(argv[firstArg + 1]));
+            firstArg += 2;
+        } else if (option == "--ir") {
+            viaIr = true;
+            firstArg++;
+        } else if (option == "--no-fold") {
+            constantFolding = false;
+            firstArg++;
+        } else {
+            break;
+        }
+    }
+    if (argc - firstArg != 1) {
+        std::cerr << "Usage: " << argv[0] << " [-j <threads>] [--ir] [--no-fold] <project_dir>\n";
+        return 1;
+    }
+
+    fs::path projectDir = argv[firstArg];
+    fs::path inputDir = projectDir / "test" / "input";
+    fs::path outputDir = projectDir / "test" / "output";
+    fs::path expectedDir = projectDir / "test" / "expected_vm_output";
+    fs::create_directories(outputDir);
+
+    std::vector<TestCase> tests;
+    for (const auto& entry : fs::directory_iterator(inputDir)) {
+        if (entry.path().extension() != ".imp") {
+            continue;
+        }
+        TestCase test;
+        test.name = entry.path().stem().string();
+        test.source = entry.path();
+        test.expectError = test.name.find("error") != std::string::npos;
+        tests.push_back(test);
+    }
+    std::sort(tests.begin(), tests.end(),
+              [](const TestCase& a, const TestCase& b) { return a.name < b.name; });
+
+    std::ostream report(std::cout.rdbuf());
+    NullBuffer nullBuffer;
+    std::streambuf* coutBuffer = std::cout.rdbuf(&nullBuffer);
+    std::streambuf* cerrBuffer = std::cerr.rdbuf(&nullBuffer);
+
+    auto start = Clock::now();
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < std::min<size_t>(jobs, tests.size()); i++) {
+        workers.emplace_back([&] {
+            for (size_t t; (t = next++) < tests.size();) {
+                runTest(tests[t], outputDir, expectedDir);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double wallMs = millisecondsSince(start);
+
+    std::cout.rdbuf(coutBuffer);
+    std::cerr.rdbuf(cerrBuffer);
+
+    size_t passed = 0;
+    double totalMs = 0;
+    report << std::fixed << std::setprecision(2);
+    for (const auto& test : tests) {
+        passed += test.passed;
+        totalMs += test.compileMs + test.runMs;
+        report << (test.passed ? "PASSED " : "FAILED ") << std::left
+               << std::setw(10) << test.name << std::right
+               << " compile " << std::setw(8) << test.compileMs << " ms"
+               << "  run " << std::setw(8) << test.runMs << " ms";
+        if (test.passed && !test.expectError) {
+            report << "  cost " << test.cost;
+        } else {
+            report << "  " << test.message;
+        }
+        report << "\n";
+    }
+    report << "----------------------------------------\n"
+           << "Total Tests: " << tests.size() << "\n"
+           << "Passed:      " << passed << "\n"
+           << "Failed:      " << tests.size() - passed << "\n"
+           << "Threads:     " << workers.size() << "\n"
+           << "Test time:   " << totalMs << " ms\n"
+           << "Wall clock:  " << wallMs << " ms\n";
+
+    return passed == tests.size() ? 0 : 1;
+}
@@ -17,6 +17,7 @@ program_inputs = {
     "program1.imp": "30\n25\n20\n15\n",
     "program2.imp": "",
     "program3.imp": "12",
+    "test21.imp": "7\n3\n0\n",
 }
 
 unhandled_tests = [
@@ -0,0 +1,76 @@
+import importlib.util
+import os
+import subprocess
+import sys
+
+# reuse program inputs from the output tests
+spec = importlib.util.spec_from_file_location(
+    "test_runner", os.path.join(os.path.dirname(__file__), "test-runner.py")
+)
+test_runner = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(test_runner)
+
+
+def run_benchmark(bench_path, test_path, min_time):
+    test_name = os.path.splitext(os.path.basename(test_path))[0]
+    input_data = test_runner.program_inputs.get(test_name, "10\n")
+
+    try:
+        result = subprocess.run(
+            [bench_path, test_path, str(min_time)],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            input=input_data,
+            text=True,
+            check=True,
+        )
+    except subprocess.CalledProcessError as e:
+        print(f"Error while benchmarking {test_path}: {e}")
+        return None
+
+    # rozkazy: <n> przebiegi: <n> czas: <s> rozkazy/s: <n>
+    fields = result.stdout.split()
+    return int(fields[1]), float(fields[5]) / int(fields[3]), int(fields[7])
+
+
+def run_benchmarks(test_directory, bench_paths, min_time):
+    test_files = sorted(
+        f for f in os.listdir(test_directory) if f.endswith(".imp.mr")
+    )
+
+    header = f"{'test':<16}{'instructions':>14}"
+    for bench_path in bench_paths:
+        header += f"{os.path.basename(bench_path) + ' [instr/s]':>36}"
+    print(header)
+
+    total_steps = 0
+    total_time = [0.0] * len(bench_paths)
+
+    for test_file in test_files:
+        test_path = os.path.join(test_directory, test_file)
+        results = [run_benchmark(b, test_path, min_time) for b in bench_paths]
+        if any(r is None for r in results):
+            continue
+
+        steps = results[0][0]
+        total_steps += steps
+        line = f"{test_file[:-7]:<16}{steps:>14}"
+        for i, (_, run_time, speed) in enumerate(results):
+            total_time[i] += run_time
+            line += f"{speed:>36,}"
+        print(line)
+
+    line = f"{'total':<16}{total_steps:>14}"
+    for run_time in total_time:
+        line += f"{int(total_steps / run_time) if run_time else 0:>36,}"
+    print(line)
+
+
+if __name__ == "__main__":
+    # usage: python3 ../test/vm-benchmark.py [bench binary ...]
+    test_directory = "../test/output"
+    bench_paths = sys.argv[1:] or [
+        os.path.join(os.getcwd(), "maszyna-wirtualna-bench")
+    ]
+    min_time = float(os.environ.get("BENCH_MIN_TIME", "0.2"))
+    run_benchmarks(test_directory, [os.path.abspath(b) for b in bench_paths], min_time)
@@ -0,0 +1,97 @@
+/*
+ * Pomiar wydajności interpretera maszyny wirtualnej
+ *
+ * Program wczytywany jest raz, wejście (stdin) buforowane w pamięci.
+ * Liczba rozkazów pochodzi z jednego przebiegu wersji liczącej
+ * (run_machine_counted), a czas mierzony jest na zwykłym run_machine
+ * uruchamianym wielokrotnie z wyciszonym wyjściem, aż łączny czas
+ * przekroczy zadany próg.
+*/
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include <utility>
+#include <vector>
+
+#include "colors.hh"
+#include "mrb.hh"
+
+using namespace std;
+
+extern void run_parser( vector< pair<int,long long> > & program, FILE * data );
+extern void run_machine( vector< pair<int,long long> > & program );
+extern void run_machine_counted( vector< pair<int,long long> > & program );
+extern long long mw_steps;
+
+class NullBuffer : public streambuf
+{
+  protected:
+    int overflow( int c ) { return c; }
+    streamsize xsputn( const char *, streamsize n ) { return n; }
+};
+
+int main( int argc, char const * argv[] )
+{
+  vector< pair<int,long long> > program;
+  FILE * data;
+  double minTime = 1.0;
+
+  if( argc!=2 && argc!=3 )
+  {
+    cerr << cRed << "Sposób użycia programu: maszyna-wirtualna-bench kod [min_czas_s] < wejście" << cReset << endl;
+    return -1;
+  }
+  if( argc==3 )
+    minTime = atof( argv[2] );
+
+  NullBuffer null;
+  streambuf * coutBuf = cout.rdbuf( &null );
+  if( !load_binary_program( argv[1], program ) )
+  {
+    data = fopen( argv[1], "r" );
+    if( !data )
+    {
+      cout.rdbuf( coutBuf );
+      cerr << cRed << "Błąd: Nie można otworzyć pliku " << argv[1] << cReset << endl;
+      return -1;
+    }
+    run_parser( program, data );
+    fclose( data );
+  }
+
+  string input( ( istreambuf_iterator<char>( cin ) ), istreambuf_iterator<char>() );
+  streambuf * cinBuf = cin.rdbuf();
+
+  istringstream countIn( input );
+  cin.rdbuf( countIn.rdbuf() );
+  run_machine_counted( program );
+  long long steps = mw_steps;
+
+  long long runs = 0;
+  double elapsed = 0.0;
+  do
+  {
+    istringstream in( input );
+    cin.rdbuf( in.rdbuf() );
+    cin.clear();
+
+    auto start = chrono::steady_clock::now();
+    run_machine( program );
+    elapsed += chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+
+    runs++;
+  } while( elapsed<minTime );
+
+  cin.rdbuf( cinBuf );
+  cout.rdbuf( coutBuf );
+  cout.imbue( locale::classic() );
+  cout << "rozkazy: " << steps << " przebiegi: " << runs << " czas: " << elapsed
+       << " rozkazy/s: " << (long long)( steps*runs/elapsed ) << endl;
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Dekodowanie programu maszyny wirtualnej do projektu z JFTT2024
+*/
+#include <map>
+
+#include "decode.hh"
+
+using namespace std;
+
+static bool is_jump( int op )
+{
+  return op==JUMP || op==JPOS || op==JZERO || op==JNEG;
+}
+
+bool ends_block( unsigned char op )
+{
+  switch( op )
+  {
+    case JUMP: case JPOS: case JZERO: case JNEG: case RTRN: case HALT:
+    case BAD_ADDRESS: case BAD_JUMP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+long long instruction_cost( unsigned char op, long long arg )
+{
+  switch( op )
+  {
+    case GET: case PUT:				return 100;
+    case LOAD: case STORE: case ADD: case SUB:	return 10;
+    case LOADI: case STOREI: case ADDI:		return 20;
+    case SUBI:					return 12;
+    case SET:					return 50;
+    case HALF:					return 5;
+    case JUMP: case JPOS: case JZERO: case JNEG:	return 1;
+    case RTRN:					return 10;
+    case NOP:					return arg;
+    case DOUBLE: case ZERO:			return 10;
+    default:					return 0;
+  }
+}
+
+// Superinstrukcje dopasowywane są po kolei od początku programu, więc
+// sprawdzane kody kolejnych pozycji nie są jeszcze zmienione.
+static void fuse_superinstructions( DecodedProgram & code )
+{
+  unsigned char * op = code.op.data();
+
+  for( long long i=0; i<code.size; i++ )
+  {
+    // op[code.size] to wartownik, więc sekwencja nie wyjdzie poza program
+    unsigned char next = op[i+1];
+    unsigned char next2 = i+2<=code.size ? op[i+2] : (unsigned char)BAD_JUMP;
+
+    if( op[i]==LOAD && next==ADD && next2==STORE )
+      op[i] = LOAD_ADD_STORE;
+    else if( op[i]==LOAD && next==SUB && next2==STORE )
+      op[i] = LOAD_SUB_STORE;
+    else if( op[i]==LOAD && next==SUB && next2==JPOS )
+      op[i] = LOAD_SUB_JPOS;
+    else if( op[i]==LOAD && next==SUB && next2==JZERO )
+      op[i] = LOAD_SUB_JZERO;
+    else if( op[i]==LOAD && next==SUB && next2==JNEG )
+      op[i] = LOAD_SUB_JNEG;
+    else if( op[i]==LOAD && next==STORE )
+      op[i] = LOAD_STORE;
+    else if( op[i]==SET && next==STORE )
+      op[i] = SET_STORE;
+  }
+}
+
+void decode_program( vector< pair<int,long long> > const & program, DecodedProgram & code, bool fuse )
+{
+  long long n = program.size();
+  map<long long,long long> traps;	// numer rozkazu spoza programu -> wartownik
+
+  code.size = n;
+  code.op.assign( n+1, BAD_JUMP );
+  code.arg.assign( n+1, n );	// rozkaz n: zejście z końca programu
+  traps[n] = n;
+
+  auto trap = [&]( long long target ) -> long long
+  {
+    if( target>=0 && target<n )
+      return target;
+    auto it = traps.find( target );
+    if( it!=traps.end() )
+      return it->second;
+    code.op.push_back( BAD_JUMP );
+    code.arg.push_back( target );
+    traps[target] = code.op.size()-1;
+    return code.op.size()-1;
+  };
+
+  for( long long i=0; i<n; i++ )
+  {
+    int op = program[i].first;
+    long long arg = program[i].second;
+
+    code.op[i] = op;
+    code.arg[i] = arg;
+
+    if( is_jump( op ) )
+      code.arg[i] = trap( i+arg );
+    else if( op!=SET && arg<0 )
+      code.op[i] = BAD_ADDRESS;
+    else if( arg==0 )
+    {
+      // bezpośrednie odwołania do p[0] dotyczą akumulatora
+      switch( op )
+      {
+        case LOAD:
+        case STORE:	code.op[i] = NOP; code.arg[i] = 10; break;
+        case ADD:	code.op[i] = DOUBLE; break;
+        case SUB:	code.op[i] = ZERO; break;
+        default: break;
+      }
+    }
+  }
+
+  // koszty liczone przed łączeniem w superinstrukcje
+  long long slots = code.op.size();
+  code.cost.assign( slots, 0 );
+  for( long long k=slots-1; k>=0; k-- )
+    code.cost[k] = instruction_cost( code.op[k], code.arg[k] )
+                   + ( ends_block( code.op[k] ) ? 0 : code.cost[k+1] );
+
+  if( fuse )
+    fuse_superinstructions( code );
+}
@@ -0,0 +1,62 @@
+/*
+ * Dekodowanie programu maszyny wirtualnej do projektu z JFTT2024
+ *
+ * Program z parsera zamieniany jest jednorazowo na tablicę kodów rozkazów
+ * (po jednym bajcie) i tablicę argumentów. Wszystkie statyczne argumenty
+ * i cele skoków sprawdzane są tutaj, więc pętla interpretera nie wykonuje
+ * żadnych testów poprawności poza RTRN.
+ *
+ * Częste sekwencje rozkazów generowanych przez kompilator łączone są
+ * w superinstrukcje wykonywane w jednym kroku. Superinstrukcja zastępuje
+ * tylko kod pierwszego rozkazu sekwencji, a argumenty czyta z kolejnych
+ * pozycji, które pozostają nietknięte - skok w środek sekwencji działa
+ * więc jak wcześniej. Koszt jest sumą kosztów zastąpionych rozkazów.
+ *
+ * Dla każdego rozkazu liczony jest też koszt ciągu od niego do najbliższego
+ * rozkazu kończącego ciąg (włącznie). Interpreter dolicza go przy wejściu
+ * na początek programu i po każdym skoku, więc pozostałe rozkazy nie
+ * zmieniają t. Ciąg kończy się tylko na skokach, RTRN, HALT i błędach,
+ * więc koszt w chwili zatrzymania jest taki sam, jak przy liczeniu
+ * każdego rozkazu osobno.
+*/
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "instructions.hh"
+
+// Rozkazy wewnętrzne, numerowane dalej niż te z instructions.hh.
+enum DecodedInstructions : unsigned char
+{
+  NOP = HALT+1,	// LOAD 0 i STORE 0; argumentem jest koszt
+  DOUBLE,	// ADD 0
+  ZERO,		// SUB 0
+  LOAD_ADD_STORE,	// LOAD a; ADD b; STORE c
+  LOAD_SUB_STORE,	// LOAD a; SUB b; STORE c
+  LOAD_SUB_JPOS,	// LOAD a; SUB b; JPOS j
+  LOAD_SUB_JZERO,	// LOAD a; SUB b; JZERO j
+  LOAD_SUB_JNEG,	// LOAD a; SUB b; JNEG j
+  LOAD_STORE,		// LOAD a; STORE b
+  SET_STORE,		// SET k; STORE a
+  BAD_ADDRESS,	// rozkaz z ujemnym adresem pamięci
+  BAD_JUMP,	// wartownik: wyjście poza program, argumentem jest numer rozkazu
+  DECODED_END
+};
+
+struct DecodedProgram
+{
+  std::vector<unsigned char> op;
+  std::vector<long long> arg;	// dla skoków: bezwzględny numer rozkazu
+  std::vector<long long> cost;	// koszt t od rozkazu do końca ciągu bez skoków
+  long long size;		// liczba rozkazów bez wartowników
+};
+
+// Rozkazy kończące ciąg wykonywany bez skoków (skoki, RTRN, HALT, błędy).
+bool ends_block( unsigned char op );
+
+// Koszt t rozkazu zdekodowanego bez superinstrukcji.
+long long instruction_cost( unsigned char op, long long arg );
+
+// fuse=false zostawia rozkazy bez superinstrukcji (dla kompilatora JIT).
+void decode_program( std::vector< std::pair<int,long long> > const & program, DecodedProgram & code, bool fuse = true );
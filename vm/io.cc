@@ -0,0 +1,213 @@
+/*
+ * Wejście/wyjście maszyny wirtualnej do projektu z JFTT2024
+*/
+#include <iostream>
+
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.hh"
+
+using namespace std;
+
+namespace {
+
+bool batchMode = false;
+
+class BatchInput
+{
+  public:
+    // Zwraca następny znak bez pobierania go albo EOF.
+    int peek()
+    {
+      if( pos==end && !refill() )
+        return EOF;
+      return (unsigned char)*pos;
+    }
+
+    void skip() { pos++; }
+
+  private:
+    bool refill()
+    {
+      if( !started )
+      {
+        started = true;
+        struct stat st;
+        if( fstat( 0, &st )==0 && S_ISREG( st.st_mode ) && st.st_size>0 )
+        {
+          void * data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0 );
+          if( data!=MAP_FAILED )
+          {
+            mapped = true;
+            pos = (char const *)data;
+            end = pos+st.st_size;
+            return true;
+          }
+        }
+      }
+      if( mapped )
+        return false;
+      ssize_t n = read( 0, buffer, sizeof( buffer ) );
+      if( n<=0 )
+        return false;
+      pos = buffer;
+      end = buffer+n;
+      return true;
+    }
+
+    char buffer[1 << 16];
+    char const * pos = nullptr;
+    char const * end = nullptr;
+    bool started = false;
+    bool mapped = false;
+};
+
+class BatchOutput
+{
+  public:
+    void write( long long v )
+    {
+      if( len>sizeof( buffer )-24 )
+        flush();
+      char digits[20];
+      int n = 0;
+      unsigned long long x = v<0 ? 0ULL-(unsigned long long)v : v;
+      do
+      {
+        digits[n++] = '0'+x%10;
+        x /= 10;
+      } while( x );
+      if( v<0 )
+        buffer[len++] = '-';
+      while( n )
+        buffer[len++] = digits[--n];
+      buffer[len++] = '\n';
+    }
+
+    void flush()
+    {
+      fwrite( buffer, 1, len, stdout );
+      fflush( stdout );
+      len = 0;
+    }
+
+  private:
+    char buffer[1 << 16];
+    size_t len = 0;
+};
+
+BatchInput input;
+BatchOutput output;
+bool inputFailed = false;
+
+// Zachowuje się jak cin >> v: przy końcu danych v się nie zmienia, błędna
+// liczba daje 0, a przekroczenie zakresu - wartość graniczną; po błędzie
+// kolejne odczyty nic już nie zmieniają.
+long long batch_read( long long v )
+{
+  if( inputFailed )
+    return v;
+
+  int c;
+  while( ( c = input.peek() )!=EOF && isspace( c ) )
+    input.skip();
+  if( c==EOF )
+  {
+    inputFailed = true;
+    return v;
+  }
+
+  bool negative = c=='-';
+  if( c=='-' || c=='+' )
+  {
+    input.skip();
+    c = input.peek();
+  }
+  if( c==EOF || !isdigit( c ) )
+  {
+    inputFailed = true;
+    return 0;
+  }
+
+  unsigned long long x = 0;
+  unsigned long long limit = negative ? 1ULL+LLONG_MAX : LLONG_MAX;
+  bool overflow = false;
+  while( ( c = input.peek() )!=EOF && isdigit( c ) )
+  {
+    unsigned d = c-'0';
+    if( x>( limit-d )/10 )
+      overflow = true;
+    else
+      x = x*10+d;
+    input.skip();
+  }
+  if( overflow )
+  {
+    inputFailed = true;
+    return negative ? LLONG_MIN : LLONG_MAX;
+  }
+  return negative ? -(long long)( x-1 )-1 : (long long)x;
+}
+
+}
+
+void set_batch_io( bool batch )
+{
+  batchMode = batch;
+  if( batch )
+    atexit( flush_output );	// także przy wyjściu z błędem
+}
+
+bool batch_io()
+{
+  return batchMode;
+}
+
+long long read_value( long long v )
+{
+  if( batchMode )
+    return batch_read( v );
+  cout << "? ";
+  cin >> v;
+  return v;
+}
+
+void write_value( long long v )
+{
+  if( batchMode )
+  {
+    output.write( v );
+    return;
+  }
+  cout << "> " << v << endl;
+}
+
+void flush_output()
+{
+  if( batchMode )
+    output.flush();
+}
+
+namespace {
+
+class StreamIO : public MachineIO
+{
+  public:
+    long long read( long long v ) override { return read_value( v ); }
+    void write( long long v ) override { write_value( v ); }
+};
+
+}
+
+MachineIO & stream_io()
+{
+  static StreamIO io;
+  return io;
+}
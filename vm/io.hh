@@ -0,0 +1,27 @@
+/*
+ * Wejście/wyjście maszyny wirtualnej (GET/PUT) do projektu z JFTT2024
+ *
+ * Domyślnie każdy GET wypisuje "? " i czyta przez cin, a PUT wypisuje
+ * "> wartość" z endl. W trybie wsadowym (--batch) znaki zachęty są
+ * pomijane, liczby czytane są szybkim parserem z dużego bufora (plik
+ * na stdin jest mapowany w pamięć), a wyjście - same liczby, po jednej
+ * w wierszu - trafia do bufora opróżnianego rzadko. Koszt się nie zmienia.
+*/
+#pragma once
+
+#include "machine.hh"
+
+void set_batch_io( bool batch );
+bool batch_io();
+
+// GET: v to bieżąca wartość komórki, zwracana bez zmian przy braku danych
+long long read_value( long long v );
+
+// PUT
+void write_value( long long v );
+
+// Opróżnia bufor wyjścia; wywoływane przed komunikatem końcowym.
+void flush_output();
+
+// read_value/write_value jako MachineIO dla execute_machine
+MachineIO & stream_io();
@@ -0,0 +1,402 @@
+/*
+ * Kompilator JIT (x86-64) maszyny rejestrowej do projektu z JFTT2024
+ *
+ * Każdy rozkaz zdekodowanego programu tłumaczony jest na stały szablon
+ * kodu maszynowego. W trakcie działania:
+ *   r12 - akumulator,       r13 - koszt t,        r14 - koszt i/o,
+ *   rbx - gęsta pamięć,     rbp - tablica wejść,  r15 - stan maszyny.
+ * Wysokie adresy, GET, PUT i błędy obsługują zwykłe funkcje C++.
+ *
+ * Koszt doliczany jest przy wejściu do ciągu rozkazów zakończonego skokiem
+ * (lub HALT): wykonanie od rozkazu k zawsze dochodzi do końca ciągu, więc
+ * na wejściu dodawana jest suma kosztów od k do końca ciągu. Wejście na
+ * początek ciągu jest w kodzie przed pierwszym rozkazem, wejścia w środek
+ * ciągu (cele skoków, RTRN) mają osobne krótkie wstawki.
+*/
+#include <iostream>
+#include <locale>
+
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "instructions.hh"
+#include "colors.hh"
+#include "decode.hh"
+#include "io.hh"
+#include "memory.hh"
+
+using namespace std;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+namespace {
+
+struct JitState
+{
+  PagedMemory * p;
+  long long t;
+  long long io;
+};
+
+enum Register { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+enum Condition { CC_AE = 0x3, CC_E = 0x4, CC_L = 0xc, CC_G = 0xf };
+
+// Funkcje wywoływane z wygenerowanego kodu
+
+long long * jit_cell( JitState * s, unsigned long long a )
+{
+  return &(*s->p)[a];
+}
+
+long long jit_get( JitState * s, unsigned long long a, long long acc )
+{
+  long long & v = a==0 ? acc : (*s->p)[a];
+  v = read_value( v );
+  return acc;
+}
+
+long long jit_put( JitState * s, unsigned long long a, long long acc )
+{
+  write_value( a==0 ? acc : (*s->p)[a] );
+  return acc;
+}
+
+[[noreturn]] void jit_bad_address()
+{
+  cerr << cRed << "Błąd: ujemny adres pamięci." << cReset << endl;
+  exit(-1);
+}
+
+[[noreturn]] void jit_bad_jump( long long lr )
+{
+  cerr << cRed << "Błąd: Wywołanie nieistniejącej instrukcji nr " << lr << "." << cReset << endl;
+  exit(-1);
+}
+
+// Minimalny asembler: tylko formy rozkazów potrzebne w szablonach.
+class Assembler
+{
+  public:
+    vector<unsigned char> code;
+
+    size_t pos() const { return code.size(); }
+
+    void byte( unsigned char b ) { code.push_back( b ); }
+    void dword( long long v ) { for( int i=0; i<4; i++ ) byte( v >> (8*i) ); }
+    void qword( long long v ) { for( int i=0; i<8; i++ ) byte( v >> (8*i) ); }
+
+    void rex( int reg, int rm ) { byte( 0x48 | ((reg>>3)<<2) | (rm>>3) ); }
+
+    // opc reg, [base+disp32] (lub odwrotnie, zależnie od opc)
+    void mem( unsigned char opc, int reg, int base, long long disp )
+    {
+      rex( reg, base );
+      byte( opc );
+      byte( 0x80 | ((reg&7)<<3) | (base&7) );
+      if( (base&7)==RSP )
+        byte( 0x24 );
+      dword( disp );
+    }
+
+    // opc rm, reg
+    void rr( unsigned char opc, int rm, int reg )
+    {
+      rex( reg, rm );
+      byte( opc );
+      byte( 0xc0 | ((reg&7)<<3) | (rm&7) );
+    }
+
+    void mov_imm( int r, long long v ) { rex( 0, r ); byte( 0xb8 | (r&7) ); qword( v ); }
+
+    // ext: 0 - add, 5 - sub, 7 - cmp
+    void alu_imm( int ext, int r, long long v )
+    {
+      rex( 0, r );
+      byte( 0x81 );
+      byte( 0xc0 | (ext<<3) | (r&7) );
+      dword( v );
+    }
+
+    void add_imm( int r, long long v )
+    {
+      if( v==0 )
+        return;
+      if( v>=-0x80000000LL && v<=0x7fffffffLL )
+        alu_imm( 0, r, v );
+      else
+      {
+        mov_imm( RAX, v );
+        rr( 0x01, r, RAX );
+      }
+    }
+
+    void push( int r ) { if( r>=R8 ) byte( 0x41 ); byte( 0x50 | (r&7) ); }
+    void pop( int r ) { if( r>=R8 ) byte( 0x41 ); byte( 0x58 | (r&7) ); }
+    void call( void * f ) { mov_imm( RAX, (long long)f ); byte( 0xff ); byte( 0xd0 ); }
+
+    // Skoki względne; zwracają miejsce do uzupełnienia przez patch().
+    size_t jmp() { byte( 0xe9 ); dword( 0 ); return pos()-4; }
+    size_t jcc( Condition cc ) { byte( 0x0f ); byte( 0x80 | cc ); dword( 0 ); return pos()-4; }
+
+    void patch( size_t at, size_t target )
+    {
+      int rel = (long long)target - (long long)(at+4);
+      memcpy( &code[at], &rel, 4 );
+    }
+};
+
+class JitCompiler
+{
+  public:
+    JitCompiler( DecodedProgram const & code ) : code( code ) {}
+
+    void compile();
+
+    static constexpr size_t NONE = (size_t)-1;
+
+    vector<size_t> entry;	// wejście do rozkazu k z doliczeniem kosztu
+    size_t start;
+    Assembler a;
+
+  private:
+    // rax := adres komórki a (a>0)
+    void cell_address( unsigned long long addr )
+    {
+      a.mov_imm( RSI, addr );
+      a.rr( 0x89, RDI, R15 );
+      a.call( (void *)jit_cell );
+    }
+
+    // opc r12, p[addr] / opc p[addr], r12 dla bezpośredniego adresu addr>0
+    void direct( unsigned char opc, unsigned long long addr )
+    {
+      if( addr<PagedMemory::DENSE_SIZE )
+        a.mem( opc, R12, RBX, addr*8 );
+      else
+      {
+        cell_address( addr );
+        a.mem( opc, R12, RAX, 0 );
+      }
+    }
+
+    // rax := p[addr]
+    void load_rax( unsigned long long addr )
+    {
+      if( addr==0 )
+        a.rr( 0x89, RAX, R12 );
+      else if( addr<PagedMemory::DENSE_SIZE )
+        a.mem( 0x8b, RAX, RBX, addr*8 );
+      else
+      {
+        cell_address( addr );
+        a.mem( 0x8b, RAX, RAX, 0 );
+      }
+    }
+
+    // rax := adres komórki p[p[addr]] (p[0] to akumulator, zrzucany do
+    // gęstej komórki 0, której nie używa żadne odwołanie bezpośrednie)
+    void indirect_address( unsigned long long addr )
+    {
+      load_rax( addr );
+      a.mem( 0x89, R12, RBX, 0 );
+      a.alu_imm( 7, RAX, PagedMemory::DENSE_SIZE );
+      size_t slow = a.jcc( CC_AE );
+      a.byte( 0x48 ); a.byte( 0x8d ); a.byte( 0x04 ); a.byte( 0xc3 );	// lea rax, [rbx+rax*8]
+      size_t done = a.jmp();
+      a.patch( slow, a.pos() );
+      a.rr( 0x89, RSI, RAX );
+      a.rr( 0x89, RDI, R15 );
+      a.call( (void *)jit_cell );
+      a.patch( done, a.pos() );
+    }
+
+    void jump_to( size_t at, long long target ) { fixups.push_back( { at, target } ); }
+
+    void charge( long long k )
+    {
+      a.add_imm( R13, code.cost[k] );
+      a.add_imm( R14, io[k] );
+    }
+
+    void instruction( long long k );
+
+    DecodedProgram const & code;
+    vector<long long> io;	// koszt i/o od k do końca ciągu (t: code.cost)
+    vector< pair<size_t,long long> > fixups;
+    size_t halt;
+};
+
+void JitCompiler::instruction( long long k )
+{
+  long long arg = code.arg[k];
+
+  switch( code.op[k] )
+  {
+    case GET:
+    case PUT:
+      a.rr( 0x89, RDX, R12 );
+      a.mov_imm( RSI, arg );
+      a.rr( 0x89, RDI, R15 );
+      a.call( code.op[k]==GET ? (void *)jit_get : (void *)jit_put );
+      a.rr( 0x89, R12, RAX );
+      break;
+    case LOAD:	direct( 0x8b, arg ); break;
+    case STORE:	direct( 0x89, arg ); break;
+    case ADD:	direct( 0x03, arg ); break;
+    case SUB:	direct( 0x2b, arg ); break;
+    case LOADI:	indirect_address( arg ); a.mem( 0x8b, R12, RAX, 0 ); break;
+    case STOREI:	indirect_address( arg ); a.mem( 0x89, R12, RAX, 0 ); break;
+    case ADDI:	indirect_address( arg ); a.mem( 0x03, R12, RAX, 0 ); break;
+    case SUBI:	indirect_address( arg ); a.mem( 0x2b, R12, RAX, 0 ); break;
+    case SET:	a.mov_imm( R12, arg ); break;
+    case HALF:	a.rex( 0, R12 ); a.byte( 0xd1 ); a.byte( 0xf8 | (R12&7) ); break;
+    case NOP:	break;
+    case DOUBLE:	a.rr( 0x01, R12, R12 ); break;
+    case ZERO:	a.rr( 0x31, R12, R12 ); break;
+    case JUMP:	jump_to( a.jmp(), arg ); break;
+    case JPOS:
+    case JZERO:
+    case JNEG:
+      a.rr( 0x85, R12, R12 );
+      jump_to( a.jcc( code.op[k]==JPOS ? CC_G : code.op[k]==JZERO ? CC_E : CC_L ), arg );
+      break;
+    case RTRN:
+    {
+      load_rax( arg );
+      a.alu_imm( 7, RAX, code.size );
+      size_t bad = a.jcc( CC_AE );	// bez znaku: ujemne też poza programem
+      a.byte( 0xff ); a.byte( 0x64 ); a.byte( 0xc5 ); a.byte( 0x00 );	// jmp [rbp+rax*8]
+      a.patch( bad, a.pos() );
+      a.rr( 0x89, RDI, RAX );
+      a.call( (void *)jit_bad_jump );
+      break;
+    }
+    case HALT:	jump_to( a.jmp(), -1 ); break;
+    case BAD_ADDRESS:	a.call( (void *)jit_bad_address ); break;
+    case BAD_JUMP:
+      a.mov_imm( RDI, arg );
+      a.call( (void *)jit_bad_jump );
+      break;
+  }
+}
+
+void JitCompiler::compile()
+{
+  long long slots = code.op.size();
+
+  io.assign( slots+1, 0 );
+  for( long long k=slots-1; k>=0; k-- )
+    io[k] = ( code.op[k]==GET || code.op[k]==PUT ? 100 : 0 ) + ( ends_block( code.op[k] ) ? 0 : io[k+1] );
+
+  // void f( JitState * s, size_t const * entries, long long * dense )
+  start = a.pos();
+  for( int r : { RBX, RBP, R12, R13, R14, R15 } )
+    a.push( r );
+  a.alu_imm( 5, RSP, 8 );	// wyrównanie stosu do 16 przed wywołaniami
+  a.rr( 0x89, R15, RDI );
+  a.rr( 0x89, RBP, RSI );
+  a.rr( 0x89, RBX, RDX );
+  a.rr( 0x31, R12, R12 );
+  a.rr( 0x31, R13, R13 );
+  a.rr( 0x31, R14, R14 );
+  jump_to( a.jmp(), 0 );
+
+  halt = a.pos();
+  a.mem( 0x89, R13, R15, offsetof( JitState, t ) );
+  a.mem( 0x89, R14, R15, offsetof( JitState, io ) );
+  a.alu_imm( 0, RSP, 8 );
+  for( int r : { R15, R14, R13, R12, RBP, RBX } )
+    a.pop( r );
+  a.byte( 0xc3 );
+
+  entry.assign( slots, NONE );
+  vector<size_t> body( slots );
+  for( long long k=0; k<slots; k++ )
+  {
+    bool trap = code.op[k]==BAD_JUMP || code.op[k]==BAD_ADDRESS;
+    if( !trap && ( k==0 || ends_block( code.op[k-1] ) ) )
+    {
+      entry[k] = a.pos();
+      charge( k );
+    }
+    body[k] = a.pos();
+    if( trap )
+      entry[k] = body[k];
+    instruction( k );
+  }
+
+  // wejścia w środek ciągu
+  for( long long k=0; k<slots; k++ )
+    if( entry[k]==NONE )
+    {
+      entry[k] = a.pos();
+      charge( k );
+      a.patch( a.jmp(), body[k] );
+    }
+
+  for( auto & f : fixups )
+    a.patch( f.first, f.second<0 ? halt : entry[f.second] );
+}
+
+} // namespace
+
+void run_machine_jit( vector< pair<int,long long> > & program )
+{
+  DecodedProgram code;
+  PagedMemory p;
+  JitState s = { &p, 0, 0 };
+
+  decode_program( program, code, false );
+
+  JitCompiler jit( code );
+  jit.compile();
+
+  size_t size = jit.a.code.size();
+  void * mem = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( mem==MAP_FAILED )
+  {
+    cerr << cRed << "Błąd: nie można przydzielić pamięci na kod JIT." << cReset << endl;
+    exit(-1);
+  }
+  memcpy( mem, jit.a.code.data(), size );
+  if( mprotect( mem, size, PROT_READ | PROT_EXEC )!=0 )
+  {
+    cerr << cRed << "Błąd: nie można przydzielić pamięci na kod JIT." << cReset << endl;
+    exit(-1);
+  }
+
+  unsigned char * base = (unsigned char *)mem;
+  vector<unsigned char *> entries( code.size );
+  for( long long k=0; k<code.size; k++ )
+    entries[k] = base + jit.entry[k];
+
+  cout << cBlue << "Uruchamianie programu." << cReset << endl;
+  auto run = (void (*)( JitState *, unsigned char * const *, long long * ))( base + jit.start );
+  run( &s, entries.data(), p.denseData() );
+
+  munmap( mem, size );
+  flush_output();
+
+  cout.imbue(std::locale(""));
+  cout << cBlue << "Skończono program (koszt: " << cRed << s.t << cBlue << "; w tym i/o: " << s.io << ")." << cReset << endl;
+}
+
+#else
+
+extern void run_machine( vector< pair<int,long long> > & program );
+
+// Na innych platformach tryb JIT wykonuje program interpreterem.
+void run_machine_jit( vector< pair<int,long long> > & program )
+{
+  cerr << cRed << "Uwaga: JIT dostępny tylko na x86-64 (Linux), używam interpretera." << cReset << endl;
+  run_machine( program );
+}
+
+#endif
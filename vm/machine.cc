@@ -0,0 +1,31 @@
+/*
+ * Maszyna wirtualna jako biblioteka (vm_lib) do projektu z JFTT2024
+*/
+#include "machine.hh"
+
+using namespace std;
+
+namespace {
+
+class SpanIO : public MachineIO
+{
+  public:
+    SpanIO( long long const * input, size_t inputSize, vector<long long> & output )
+      : next( input ), end( input+inputSize ), output( output ) {}
+
+    long long read( long long v ) override { return next!=end ? *next++ : v; }
+    void write( long long v ) override { output.push_back( v ); }
+
+  private:
+    long long const * next;
+    long long const * end;
+    vector<long long> & output;
+};
+
+}
+
+MachineResult execute_machine( DecodedProgram const & code, long long const * input, size_t inputSize, vector<long long> & output )
+{
+  SpanIO io( input, inputSize, output );
+  return execute_machine( code, io );
+}
@@ -0,0 +1,46 @@
+/*
+ * Maszyna wirtualna jako biblioteka (vm_lib) do projektu z JFTT2024
+ *
+ * execute_machine wykonuje zdekodowany program w bieżącym procesie: nic
+ * nie wypisuje i nie kończy procesu. GET/PUT obsługuje przekazany
+ * MachineIO, a koszt i rodzaj błędu zwracane są w wyniku. run_machine
+ * (maszyna-wirtualna) to tylko otoczka wypisująca komunikaty na cout.
+*/
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "decode.hh"
+
+enum MachineStatus
+{
+  MACHINE_HALT,		// HALT
+  MACHINE_BAD_ADDRESS,	// rozkaz z ujemnym adresem pamięci
+  MACHINE_BAD_JUMP	// skok lub RTRN poza program
+};
+
+struct MachineResult
+{
+  MachineStatus status;
+  long long cost;	// t
+  long long io;		// część kosztu przypadająca na GET/PUT
+  long long lr;		// MACHINE_BAD_JUMP: numer nieistniejącego rozkazu,
+			// MACHINE_BAD_ADDRESS: numer błędnego rozkazu
+};
+
+class MachineIO
+{
+  public:
+    virtual ~MachineIO() {}
+    // GET: v to bieżąca wartość komórki, zwracana bez zmian przy braku danych
+    virtual long long read( long long v ) = 0;
+    // PUT
+    virtual void write( long long v ) = 0;
+};
+
+MachineResult execute_machine( DecodedProgram const & code, MachineIO & io );
+
+// Wejście z tablicy (po jej wyczerpaniu GET nie zmienia komórki), wyjście
+// dopisywane na koniec output.
+MachineResult execute_machine( DecodedProgram const & code, long long const * input, std::size_t inputSize, std::vector<long long> & output );
@@ -6,40 +6,95 @@
  * 2024-11-11
 */
 #include <iostream>
+#include <string>
 
 #include <utility>
 #include <vector>
 
 #include "colors.hh"
+#include "io.hh"
+#include "mrb.hh"
+#include "profile.hh"
 
 using namespace std;
 
 extern void run_parser( vector< pair<int,long long> > & program, FILE * data );
 extern void run_machine( vector< pair<int,long long> > & program );
+#ifndef MW_CLN
+extern void run_machine_jit( vector< pair<int,long long> > & program );
+extern void run_machine_profiled( vector< pair<int,long long> > & program );
+#endif
 
 int main( int argc, char const * argv[] )
 {
   vector< pair<int,long long> > program;
   FILE * data;
+#ifndef MW_CLN
+  bool jit = false;
+  char const * profile = nullptr;
+#endif
 
-  if( argc!=2 )
+  for( ; argc>2; argv++, argc-- )
   {
-    cerr << cRed << "Sposób użycia programu: interpreter kod" << cReset << endl;
-    return -1;
+#ifdef MW_CLN
+    // wersja cln nie ma kompilatora JIT ani profilu
+    if( string( argv[1] )=="--jit" || string( argv[1] )=="--profile" )
+    {
+      cerr << cRed << "Błąd: opcja " << argv[1] << " niedostępna w wersji cln." << cReset << endl;
+      return -1;
+    }
+#else
+    if( string( argv[1] )=="--jit" )
+      jit = true;
+    else if( string( argv[1] )=="--profile" && argc>3 )
+    {
+      profile = argv[2];
+      argv++;
+      argc--;
+    }
+    else
+#endif
+    if( string( argv[1] )=="--batch" )
+      set_batch_io( true );
+    else
+      break;
   }
 
-  data = fopen( argv[1], "r" );
-  if( !data )
+  if( argc!=2 )
   {
-    cerr << cRed << "Błąd: Nie można otworzyć pliku " << argv[1] << cReset << endl;
+#ifdef MW_CLN
+    cerr << cRed << "Sposób użycia programu: interpreter [--batch] kod" << cReset << endl;
+#else
+    cerr << cRed << "Sposób użycia programu: interpreter [--jit] [--batch] [--profile plik] kod" << cReset << endl;
+#endif
     return -1;
   }
 
-  run_parser( program, data );
+  if( !load_binary_program( argv[1], program ) )
+  {
+    data = fopen( argv[1], "r" );
+    if( !data )
+    {
+      cerr << cRed << "Błąd: Nie można otworzyć pliku " << argv[1] << cReset << endl;
+      return -1;
+    }
+
+    run_parser( program, data );
 
-  fclose( data );
+    fclose( data );
+  }
 
-  run_machine( program );
+#ifndef MW_CLN
+  if( profile )
+  {
+    run_machine_profiled( program );
+    write_profile( program, profile );
+  }
+  else if( jit )
+    run_machine_jit( program );
+  else
+#endif
+    run_machine( program );
 
   return 0;
 }
@@ -0,0 +1,60 @@
+/*
+ * Pamięć maszyny wirtualnej do projektu z JFTT2024
+ *
+ * Niskie adresy trzymane są w gęstej tablicy, wysokie (rzadkie)
+ * w leniwie przydzielanych stronach stałego rozmiaru.
+ * Komórki nigdy nie zapisane mają wartość 0 (tak jak w map<>).
+ * Typ komórki jest parametrem, żeby wersja cln mogła użyć tej samej pamięci.
+*/
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+template<typename Cell>
+class BasicPagedMemory
+{
+  public:
+    static constexpr unsigned long long DENSE_SIZE = 1ULL << 12;
+    static constexpr unsigned long long PAGE_BITS = 10;
+    static constexpr unsigned long long PAGE_SIZE = 1ULL << PAGE_BITS;
+
+    BasicPagedMemory() : dense( DENSE_SIZE, Cell( 0 ) ), lastPage( 0 ), lastData( nullptr ) {}
+
+    // Adres traktowany jest jako 64-bitowa liczba bez znaku, więc ujemne
+    // adresy pośrednie trafiają na (rzadkie) strony na końcu przestrzeni.
+    Cell & operator[]( unsigned long long a )
+    {
+      if( a<DENSE_SIZE )
+        return dense[a];
+      return paged( a );
+    }
+
+    std::size_t allocatedPages() const { return pages.size(); }
+
+    // Początek gęstej części (adresy 0 .. DENSE_SIZE-1), dla kodu JIT.
+    Cell * denseData() { return dense.data(); }
+
+  private:
+    Cell & paged( unsigned long long a )
+    {
+      unsigned long long page = a >> PAGE_BITS;
+      if( lastData==nullptr || page!=lastPage )
+      {
+        std::unique_ptr<Cell[]> & data = pages[page];
+        if( !data )
+          data.reset( new Cell[PAGE_SIZE]() );
+        lastPage = page;
+        lastData = data.get();
+      }
+      return lastData[a & (PAGE_SIZE-1)];
+    }
+
+    std::vector<Cell> dense;
+    std::unordered_map<unsigned long long, std::unique_ptr<Cell[]> > pages;
+    unsigned long long lastPage;
+    Cell * lastData;
+};
+
+typedef BasicPagedMemory<long long> PagedMemory;
@@ -0,0 +1,76 @@
+/*
+ * Wczytywanie binarnego formatu programu (.mrb)
+*/
+#include <iostream>
+
+#include <utility>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "instructions.hh"
+#include "colors.hh"
+#include "mrb.hh"
+
+using namespace std;
+
+[[noreturn]] static void bad_file( char const * name, char const * s )
+{
+  cerr << cRed << "Błąd: " << name << ": " << s << cReset << endl;
+  exit(-1);
+}
+
+bool load_binary_program( char const * name, vector< pair<int,long long> > & program )
+{
+  int fd = open( name, O_RDONLY );
+  if( fd<0 )
+    return false;
+
+  struct stat st;
+  if( fstat( fd, &st )!=0 || st.st_size<(off_t)sizeof( mrb::Header ) )
+  {
+    close( fd );
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void * data = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( data==MAP_FAILED )
+    return false;
+
+  mrb::Header const * header = (mrb::Header const *)data;
+  if( memcmp( header->magic, mrb::MAGIC, sizeof( mrb::MAGIC ) )!=0 )
+  {
+    munmap( data, size );
+    return false;
+  }
+
+  cout << cBlue << "Czytanie kodu." << cReset << endl;
+
+  if( header->version!=mrb::VERSION )
+    bad_file( name, "nieobsługiwana wersja formatu .mrb" );
+  size_t body = size-sizeof( mrb::Header );
+  if( body%sizeof( mrb::Record )!=0 || body/sizeof( mrb::Record )!=header->count )
+    bad_file( name, "uszkodzony plik .mrb" );
+
+  mrb::Record const * record = (mrb::Record const *)( header+1 );
+  program.reserve( program.size()+header->count );
+  for( uint64_t i=0; i<header->count; i++ )
+  {
+    if( record[i].opcode>HALT )
+      bad_file( name, "nieznany rozkaz w pliku .mrb" );
+    program.push_back( make_pair( (int)record[i].opcode, (long long)record[i].operand ) );
+  }
+
+  munmap( data, size );
+
+  cout << cBlue << "Skończono czytanie kodu (liczba rozkazów: " << program.size() << ")." << cReset << endl;
+  return true;
+}
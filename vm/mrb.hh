@@ -0,0 +1,39 @@
+/*
+ * Binarny format programu (.mrb) maszyny wirtualnej do projektu z JFTT2024
+ *
+ * Nagłówek i rekordy stałej długości (little-endian), numery rozkazów
+ * jak w instructions.hh. Kompilator zapisuje ten sam format
+ * (inc/codegen/BinaryFormat.hpp) - obie definicje muszą być zgodne.
+*/
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mrb {
+
+const char MAGIC[4] = { 'M', 'R', 'B', '\0' };
+const uint32_t VERSION = 1;
+
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t count;	// liczba rekordów
+};
+
+struct Record
+{
+  uint32_t opcode;
+  uint32_t reserved;	// zawsze 0
+  int64_t operand;
+};
+
+static_assert( sizeof( Header )==16 && sizeof( Record )==16, "układ .mrb nie może zależeć od wyrównania" );
+
+}
+
+// Wczytuje program z pliku .mrb (mmap, bez parsowania). Zwraca false, gdy
+// plik nie zaczyna się nagłówkiem .mrb - wtedy czytany jest jako tekst.
+bool load_binary_program( char const * name, std::vector< std::pair<int,long long> > & program );
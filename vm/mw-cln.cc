@@ -5,6 +5,9 @@
  * http://ki.pwr.edu.pl/gebala/
  * 2024-11-11
  * (wersja cln)
+ *
+ * Komórki trzymają long long i przechodzą na cl_I dopiero przy
+ * przepełnieniu (number-cln.hh).
 */
 #include <iostream>
 #include <locale>
@@ -20,15 +23,43 @@
 
 #include "instructions.hh"
 #include "colors.hh"
+#include "io.hh"
+#include "memory.hh"
+#include "number-cln.hh"
 
 using namespace std;
 using namespace cln;
 
+// PUT: liczby z long long idą przez write_value (io.hh), duże - przez cout,
+// w trybie wsadowym po opróżnieniu jego bufora i bez znaku zachęty.
+static void put( Number const & v )
+{
+  if( !v.big() )
+    write_value( v.value() );
+  else if( batch_io() )
+  {
+    flush_output();
+    cout << v << '\n';
+  }
+  else
+    cout << "> " << v << endl;
+}
+
 void run_machine( vector< pair<int,long long> > & program )
 {
-  map<cl_I,cl_I> p;
+  BasicPagedMemory<Number> p;
+  map<cl_I,Number> bigCells;	// adresy pośrednie spoza long long
+  Number acc;			// p[0] trzymane poza pamięcią
+
+  auto cell = [&]( long long a ) -> Number & { return a==0 ? acc : p[a]; };
+  auto cellAt = [&]( Number const & a ) -> Number &
+  {
+    if( a.big() )
+      return bigCells[a.toBig()];
+    return cell( a.value() );
+  };
 
-  int lr;
+  long long lr;
 
   long long t, io;
 
@@ -38,48 +69,59 @@ void run_machine( vector< pair<int,long long> > & program )
   io = 0;
   while( program[lr].first!=HALT )	// HALT
   {
+     long long arg = program[lr].second;
      if( program[lr].first!=SET &&
          program[lr].first!=JUMP &&
          program[lr].first!=JPOS &&
          program[lr].first!=JZERO &&
          program[lr].first!=JNEG &&
-         program[lr].second<0 )
+         arg<0 )
      {
          cerr << cRed << "Błąd: ujemny adres pamięci." << cReset << endl;
          exit(-1);
      }
      switch( program[lr].first )
      {
-      case GET:	cout << "? "; cin >> p[program[lr].second]; io+=100; t+=100; lr++; break;
-      case PUT:	cout << "> " << p[program[lr].second] << endl; io+=100; t+=100; lr++; break;
+      case GET:	if( !batch_io() ) cout << "? "; cin >> cell(arg); io+=100; t+=100; lr++; break;
+      case PUT:	put( cell(arg) ); io+=100; t+=100; lr++; break;
 
-      case LOAD:	p[0] = p[program[lr].second]; t+=10; lr++; break;
-      case STORE:	p[program[lr].second] = p[0]; t+=10; lr++; break;
-      case LOADI:	p[0] = p[p[program[lr].second]]; t+=20; lr++; break;
-      case STOREI:	p[p[program[lr].second]] = p[0]; t+=20; lr++; break;
+      case LOAD:	acc = cell(arg); t+=10; lr++; break;
+      case STORE:	cell(arg) = acc; t+=10; lr++; break;
+      case LOADI:	acc = cellAt(cell(arg)); t+=20; lr++; break;
+      case STOREI:	cellAt(cell(arg)) = acc; t+=20; lr++; break;
 
-      case ADD:	        p[0] += p[program[lr].second]; t+=10; lr++; break;
-      case SUB:	        p[0] -= p[program[lr].second]; t+=10; lr++; break;
-      case ADDI:        p[0] += p[p[program[lr].second]]; t+=20; lr++; break;
-      case SUBI:        p[0] -= p[p[program[lr].second]]; t+=12; lr++; break;
+      case ADD:	        acc = acc + cell(arg); t+=10; lr++; break;
+      case SUB:	        acc = acc - cell(arg); t+=10; lr++; break;
+      case ADDI:        acc = acc + cellAt(cell(arg)); t+=20; lr++; break;
+      case SUBI:        acc = acc - cellAt(cell(arg)); t+=12; lr++; break;
 
-      case SET:	        p[0] = program[lr].second; t+=50; lr++; break;
-      case HALF:	p[0] >>= 1; t+=5; lr++; break;
+      case SET:	        acc = arg; t+=50; lr++; break;
+      case HALF:	acc = acc.half(); t+=5; lr++; break;
 
-      case JUMP: 	lr += program[lr].second; t+=1; break;
-      case JPOS:	if( p[0]>0 ) lr += program[lr].second; else lr++; t+=1; break;
-      case JZERO:	if( p[0]==0 ) lr += program[lr].second; else lr++; t+=1; break;
-      case JNEG:	if( p[0]<0 ) lr += program[lr].second; else lr++; t+=1; break;
+      case JUMP: 	lr += arg; t+=1; break;
+      case JPOS:	if( acc.sign()>0 ) lr += arg; else lr++; t+=1; break;
+      case JZERO:	if( acc.sign()==0 ) lr += arg; else lr++; t+=1; break;
+      case JNEG:	if( acc.sign()<0 ) lr += arg; else lr++; t+=1; break;
 
-      case RTRN: 	lr = cl_I_to_int(p[program[lr].second]); t+=10; break;
+      case RTRN:
+      {
+        Number const & target = cell(arg);
+        if( target.big() )
+        {
+          cerr << cRed << "Błąd: Wywołanie nieistniejącej instrukcji nr " << target << "." << cReset << endl;
+          exit(-1);
+        }
+        lr = target.value(); t+=10; break;
+      }
       default: break;
     }
-    if( lr<0 || lr>=(int)program.size() )
+    if( lr<0 || lr>=(long long)program.size() )
     {
       cerr << cRed << "Błąd: Wywołanie nieistniejącej instrukcji nr " << lr << "." << cReset << endl;
       exit(-1);
     }
   }
+  flush_output();
   cout.imbue(std::locale(""));
   cout << cBlue << "Skończono program (koszt: " << cRed << t << cBlue << "; w tym i/o: " << io << ")." << cReset << endl;
 }
@@ -11,72 +11,196 @@
 
 #include <utility>
 #include <vector>
-#include <map>
 
 #include <cstdlib> 	// rand()
 #include <ctime>
 
 #include "instructions.hh"
 #include "colors.hh"
+#include "decode.hh"
+#include "io.hh"
+#include "machine.hh"
+#include "memory.hh"
 
 using namespace std;
 
-void run_machine( vector< pair<int,long long> > & program )
+// Wersja licząca rozkazy (dla maszyna-wirtualna-bench) i wersja profilująca
+// (--profile, liczniki wykonań każdego rozkazu; bez superinstrukcji, żeby
+// liczniki odpowiadały rozkazom programu) kompilowane są pod osobnymi
+// nazwami, żeby liczniki nie zmieniały kodu zwykłego execute_machine.
+#define FUSE true
+#if defined(MW_STEPS)
+long long mw_steps;
+#define run_machine run_machine_counted
+#define execute_machine execute_machine_counted
+#define COUNT_STEP steps++
+#define COUNT_FUSED(n) steps += (n)-1
+#elif defined(MW_PROFILE)
+vector<long long> mw_profile;
+#define run_machine run_machine_profiled
+#define execute_machine execute_machine_profiled
+#define COUNT_STEP counts[lr]++
+#define COUNT_FUSED(n)
+#undef FUSE
+#define FUSE false
+#else
+#define COUNT_STEP
+#define COUNT_FUSED(n)
+#endif
+
+// Sposób wybierania obsługi rozkazu (wybierany przy kompilacji):
+//  - domyślnie jeden switch w pętli,
+//  - MW_THREADED: kod wątkowy (etykiety jako wartości, GCC/Clang), każda
+//    obsługa skacze bezpośrednio do obsługi następnego rozkazu.
+#ifdef MW_THREADED
+#define DISPATCH	COUNT_STEP; goto *dispatch[op[lr]]
+#define CASE(x)		L_##x
+#define NEXT		DISPATCH
+#else
+#define DISPATCH	for( ;; ) { COUNT_STEP; switch( op[lr] ) {
+#define CASE(x)		case x
+#define NEXT		break
+#define END_DISPATCH	} }
+#endif
+
+MachineResult execute_machine( DecodedProgram const & code, MachineIO & device )
 {
-  map<long long,long long> p;
+  PagedMemory p;
+  long long acc;	// p[0] trzymane poza pamięcią
+
+  // komórka p[0] to akumulator; odczyt i zapis przez wartość, żeby acc
+  // mogło zostać w rejestrze
+  auto load = [&]( long long a ) { return a==0 ? acc : p[a]; };
+  auto store = [&]( long long a, long long v ) { if( a==0 ) acc = v; else p[a] = v; };
 
-  int lr;
+  long long lr;
 
   long long t, io;
+  MachineStatus status = MACHINE_HALT;
+
+  unsigned char const * op = code.op.data();
+  long long const * arg = code.arg.data();
+  long long const * cost = code.cost.data();	// doliczany po każdym skoku
+  long long const size = code.size;
+#ifdef MW_PROFILE
+  mw_profile.assign( code.op.size(), 0 );
+  long long * counts = mw_profile.data();
+#endif
 
-  cout << cBlue << "Uruchamianie programu." << cReset << endl;
   lr = 0;
-  t = 0;
+  t = cost[0];
   io = 0;
-  while( program[lr].first!=HALT )	// HALT
+  acc = 0;
+#ifdef MW_STEPS
+  long long steps = 0;
+#endif
+
+#ifdef MW_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+  static void * const dispatch[] = {
+    &&L_GET, &&L_PUT, &&L_LOAD, &&L_STORE, &&L_LOADI, &&L_STOREI,
+    &&L_ADD, &&L_SUB, &&L_ADDI, &&L_SUBI, &&L_SET, &&L_HALF,
+    &&L_JUMP, &&L_JPOS, &&L_JZERO, &&L_JNEG, &&L_RTRN, &&L_HALT,
+    &&L_NOP, &&L_DOUBLE, &&L_ZERO,
+    &&L_LOAD_ADD_STORE, &&L_LOAD_SUB_STORE,
+    &&L_LOAD_SUB_JPOS, &&L_LOAD_SUB_JZERO, &&L_LOAD_SUB_JNEG,
+    &&L_LOAD_STORE, &&L_SET_STORE,
+    &&L_BAD_ADDRESS, &&L_BAD_JUMP
+  };
+  static_assert( sizeof(dispatch)/sizeof(dispatch[0])==DECODED_END, "dispatch table" );
+#endif
+
+  DISPATCH;
+
+      CASE(GET):	store( arg[lr], device.read( load(arg[lr]) ) ); io+=100; lr++; NEXT;
+      CASE(PUT):	device.write( load(arg[lr]) ); io+=100; lr++; NEXT;
+
+      CASE(LOAD):	acc = p[arg[lr]]; lr++; NEXT;
+      CASE(STORE):	p[arg[lr]] = acc; lr++; NEXT;
+      CASE(LOADI):	acc = load(load(arg[lr])); lr++; NEXT;
+      CASE(STOREI):	store( load(arg[lr]), acc ); lr++; NEXT;
+
+      CASE(ADD):	acc += p[arg[lr]]; lr++; NEXT;
+      CASE(SUB):	acc -= p[arg[lr]]; lr++; NEXT;
+      CASE(ADDI):	acc += load(load(arg[lr])); lr++; NEXT;
+      CASE(SUBI):	acc -= load(load(arg[lr])); lr++; NEXT;
+
+      CASE(SET):	acc = arg[lr]; lr++; NEXT;
+      CASE(HALF):	acc >>= 1; lr++; NEXT;
+
+      CASE(JUMP):	lr = arg[lr]; t+=cost[lr]; NEXT;
+      CASE(JPOS):	if( acc>0 ) lr = arg[lr]; else lr++; t+=cost[lr]; NEXT;
+      CASE(JZERO):	if( acc==0 ) lr = arg[lr]; else lr++; t+=cost[lr]; NEXT;
+      CASE(JNEG):	if( acc<0 ) lr = arg[lr]; else lr++; t+=cost[lr]; NEXT;
+
+      CASE(RTRN):	lr = load(arg[lr]);
+			if( (unsigned long long)lr>=(unsigned long long)size )
+			{
+			  status = MACHINE_BAD_JUMP;
+			  goto halt;
+			}
+			t+=cost[lr];
+			NEXT;
+      CASE(HALT):	goto halt;
+
+      CASE(NOP):	lr++; NEXT;
+      CASE(DOUBLE):	acc += acc; lr++; NEXT;
+      CASE(ZERO):	acc = 0; lr++; NEXT;
+
+      // superinstrukcje: argumenty kolejnych rozkazów w arg[lr+1], arg[lr+2]
+      CASE(LOAD_ADD_STORE):	acc = p[arg[lr]] + p[arg[lr+1]]; p[arg[lr+2]] = acc;
+				lr+=3; COUNT_FUSED(3); NEXT;
+      CASE(LOAD_SUB_STORE):	acc = p[arg[lr]] - p[arg[lr+1]]; p[arg[lr+2]] = acc;
+				lr+=3; COUNT_FUSED(3); NEXT;
+      CASE(LOAD_SUB_JPOS):	acc = p[arg[lr]] - p[arg[lr+1]];
+				if( acc>0 ) lr = arg[lr+2]; else lr+=3;
+				t+=cost[lr]; COUNT_FUSED(3); NEXT;
+      CASE(LOAD_SUB_JZERO):	acc = p[arg[lr]] - p[arg[lr+1]];
+				if( acc==0 ) lr = arg[lr+2]; else lr+=3;
+				t+=cost[lr]; COUNT_FUSED(3); NEXT;
+      CASE(LOAD_SUB_JNEG):	acc = p[arg[lr]] - p[arg[lr+1]];
+				if( acc<0 ) lr = arg[lr+2]; else lr+=3;
+				t+=cost[lr]; COUNT_FUSED(3); NEXT;
+      CASE(LOAD_STORE):		acc = p[arg[lr]]; p[arg[lr+1]] = acc;
+				lr+=2; COUNT_FUSED(2); NEXT;
+      CASE(SET_STORE):		acc = arg[lr]; p[arg[lr+1]] = acc;
+				lr+=2; COUNT_FUSED(2); NEXT;
+      CASE(BAD_ADDRESS):	status = MACHINE_BAD_ADDRESS; goto halt;
+      CASE(BAD_JUMP):	status = MACHINE_BAD_JUMP; lr = arg[lr]; goto halt;
+
+#ifdef MW_THREADED
+#pragma GCC diagnostic pop
+#else
+  END_DISPATCH
+#endif
+halt:
+#ifdef MW_STEPS
+  mw_steps = steps;
+#endif
+  return MachineResult{ status, t, io, lr };
+}
+
+void run_machine( vector< pair<int,long long> > & program )
+{
+  DecodedProgram code;
+
+  decode_program( program, code, FUSE );
+
+  cout << cBlue << "Uruchamianie programu." << cReset << endl;
+  MachineResult r = execute_machine( code, stream_io() );
+  switch( r.status )
   {
-     if( program[lr].first!=SET &&
-         program[lr].first!=JUMP &&
-         program[lr].first!=JPOS &&
-         program[lr].first!=JZERO &&
-         program[lr].first!=JNEG &&
-         program[lr].second<0 )
-     {
-         cerr << cRed << "Błąd: ujemny adres pamięci." << cReset << endl;
-         exit(-1);
-     }
-     switch( program[lr].first )
-     {
-      case GET:	cout << "? "; cin >> p[program[lr].second]; io+=100; t+=100; lr++; break;
-      case PUT:	cout << "> " << p[program[lr].second] << endl; io+=100; t+=100; lr++; break;
-
-      case LOAD:	p[0] = p[program[lr].second]; t+=10; lr++; break;
-      case STORE:	p[program[lr].second] = p[0]; t+=10; lr++; break;
-      case LOADI:	p[0] = p[p[program[lr].second]]; t+=20; lr++; break;
-      case STOREI:	p[p[program[lr].second]] = p[0]; t+=20; lr++; break;
-
-      case ADD:	        p[0] += p[program[lr].second]; t+=10; lr++; break;
-      case SUB:	        p[0] -= p[program[lr].second]; t+=10; lr++; break;
-      case ADDI:        p[0] += p[p[program[lr].second]]; t+=20; lr++; break;
-      case SUBI:        p[0] -= p[p[program[lr].second]]; t+=12; lr++; break;
-
-      case SET:	        p[0] = program[lr].second; t+=50; lr++; break;
-      case HALF:	p[0] >>= 1; t+=5; lr++; break;
-
-      case JUMP: 	lr += program[lr].second; t+=1; break;
-      case JPOS:	if( p[0]>0 ) lr += program[lr].second; else lr++; t+=1; break;
-      case JZERO:	if( p[0]==0 ) lr += program[lr].second; else lr++; t+=1; break;
-      case JNEG:	if( p[0]<0 ) lr += program[lr].second; else lr++; t+=1; break;
-
-      case RTRN: 	lr = p[program[lr].second]; t+=10; break;
-      default: break;
-    }
-    if( lr<0 || lr>=(int)program.size() )
-    {
-      cerr << cRed << "Błąd: Wywołanie nieistniejącej instrukcji nr " << lr << "." << cReset << endl;
+    case MACHINE_HALT:
+      break;
+    case MACHINE_BAD_ADDRESS:
+      cerr << cRed << "Błąd: ujemny adres pamięci." << cReset << endl;
+      exit(-1);
+    case MACHINE_BAD_JUMP:
+      cerr << cRed << "Błąd: Wywołanie nieistniejącej instrukcji nr " << r.lr << "." << cReset << endl;
       exit(-1);
-    }
   }
+  flush_output();
   cout.imbue(std::locale(""));
-  cout << cBlue << "Skończono program (koszt: " << cRed << t << cBlue << "; w tym i/o: " << io << ")." << cReset << endl;
+  cout << cBlue << "Skończono program (koszt: " << cRed << r.cost << cBlue << "; w tym i/o: " << r.io << ")." << cReset << endl;
 }
@@ -0,0 +1,83 @@
+/*
+ * Liczby maszyny wirtualnej w wersji cln
+ *
+ * Wartość trzymana jest jako long long, a na cl_I zamieniana dopiero gdy
+ * wynik ADD/SUB nie mieści się w 64 bitach (sprawdzane przez arytmetykę
+ * z kontrolą przepełnienia). Wynik na dużych liczbach, który znów się
+ * mieści, wraca do long long, więc typowe programy liczą tylko na int64.
+*/
+#pragma once
+
+#include <iostream>
+
+#include <cln/cln.h>
+
+class Number
+{
+  public:
+    Number() : small( 0 ), isBig( false ) {}
+    Number( long long v ) : small( v ), isBig( false ) {}
+    explicit Number( cln::cl_I const & v ) { assign( v ); }
+
+    bool big() const { return isBig; }
+    long long value() const { return small; }	// tylko gdy !big()
+    cln::cl_I toBig() const { return isBig ? large : cln::cl_I( small ); }
+
+    friend Number operator+( Number const & a, Number const & b )
+    {
+      long long r;
+      if( !a.isBig && !b.isBig && !__builtin_add_overflow( a.small, b.small, &r ) )
+        return Number( r );
+      return Number( a.toBig()+b.toBig() );
+    }
+
+    friend Number operator-( Number const & a, Number const & b )
+    {
+      long long r;
+      if( !a.isBig && !b.isBig && !__builtin_sub_overflow( a.small, b.small, &r ) )
+        return Number( r );
+      return Number( a.toBig()-b.toBig() );
+    }
+
+    // HALF: zaokrąglenie w dół, jak >>= na cl_I
+    Number half() const { return isBig ? Number( large >> 1 ) : Number( small >> 1 ); }
+
+    int sign() const
+    {
+      if( isBig )
+        return cln::minusp( large ) ? -1 : 1;	// duża liczba nie jest zerem
+      return ( small>0 ) - ( small<0 );
+    }
+
+    friend std::ostream & operator<<( std::ostream & os, Number const & n )
+    {
+      if( n.isBig )
+        return os << n.large;
+      return os << n.small;
+    }
+
+    friend std::istream & operator>>( std::istream & is, Number & n )
+    {
+      cln::cl_I v = n.toBig();
+      is >> v;
+      n.assign( v );
+      return is;
+    }
+
+  private:
+    void assign( cln::cl_I const & v )
+    {
+      isBig = cln::integer_length( v )>=64;
+      if( isBig )
+        large = v;
+      else
+      {
+        small = cln::cl_I_to_long( v );	// long ma 64 bity (LP64)
+        large = 0;
+      }
+    }
+
+    long long small;
+    bool isBig;
+    cln::cl_I large;
+};
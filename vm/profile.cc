@@ -0,0 +1,153 @@
+/*
+ * Profil wykonania programu maszyny wirtualnej do projektu z JFTT2024
+*/
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <utility>
+#include <vector>
+
+#include "instructions.hh"
+#include "colors.hh"
+#include "decode.hh"
+#include "profile.hh"
+
+using namespace std;
+
+static char const * const names[] = {
+  "GET", "PUT", "LOAD", "STORE", "LOADI", "STOREI", "ADD", "SUB", "ADDI", "SUBI",
+  "SET", "HALF", "JUMP", "JPOS", "JZERO", "JNEG", "RTRN", "HALT"
+};
+
+static const int HOT_BLOCKS = 20;
+
+struct Block
+{
+  long long start, end;	// rozkazy start .. end włącznie
+  long long count;
+  long long cost;
+};
+
+struct OpcodeTotal
+{
+  long long count = 0;
+  long long cost = 0;
+};
+
+static double percent( long long part, long long total )
+{
+  return total ? 100.0*part/total : 0.0;
+}
+
+void write_profile( vector< pair<int,long long> > const & program, char const * prefix )
+{
+  DecodedProgram code;
+  decode_program( program, code, false );
+  long long n = code.size;
+  vector<long long> const & count = mw_profile;
+
+  if( count.size()<(size_t)n )
+  {
+    cerr << cRed << "Brak profilu dla tej wersji maszyny." << cReset << endl;
+    return;
+  }
+
+  vector<long long> cost( n );
+  long long total = 0;
+  for( long long k=0; k<n; k++ )
+  {
+    cost[k] = count[k]*instruction_cost( code.op[k], code.arg[k] );
+    total += cost[k];
+  }
+
+  // Początki bloków: rozkaz 0, cele skoków, rozkazy po skokach. Cele RTRN
+  // nie są znane statycznie, więc blok zaczyna się też tam, gdzie zmienia
+  // się liczba wykonań.
+  vector<bool> leader( n+1, false );
+  leader[0] = true;
+  leader[n] = true;
+  for( long long k=0; k<n; k++ )
+  {
+    if( ends_block( code.op[k] ) )
+      leader[k+1] = true;
+    if( code.op[k]>=JUMP && code.op[k]<=JNEG && code.arg[k]<n )
+      leader[code.arg[k]] = true;
+    if( k>0 && count[k]!=count[k-1] )
+      leader[k] = true;
+  }
+
+  vector<Block> blocks;
+  vector<long long> blockOf( n );
+  for( long long k=0; k<n; k++ )
+  {
+    if( leader[k] )
+      blocks.push_back( { k, k, count[k], 0 } );
+    blocks.back().end = k;
+    blocks.back().cost += cost[k];
+    blockOf[k] = blocks.size()-1;
+  }
+
+  vector<OpcodeTotal> opcodes( HALT+1 );
+  for( long long k=0; k<n; k++ )
+  {
+    opcodes[program[k].first].count += count[k];
+    opcodes[program[k].first].cost += cost[k];
+  }
+
+  vector<long long> order( blocks.size() );
+  for( size_t i=0; i<order.size(); i++ )
+    order[i] = i;
+  sort( order.begin(), order.end(), [&]( long long a, long long b )
+  {
+    return blocks[a].cost!=blocks[b].cost ? blocks[a].cost>blocks[b].cost : a<b;
+  } );
+
+  cerr << cBlue << "Profil (koszt: " << total << ", bloki: " << blocks.size() << ")." << cReset << endl;
+  cerr << setw(16) << "blok" << setw(12) << "wykonania" << setw(16) << "koszt" << setw(8) << "%" << endl;
+  for( size_t i=0; i<order.size() && i<(size_t)HOT_BLOCKS; i++ )
+  {
+    Block const & b = blocks[order[i]];
+    if( b.cost==0 )
+      break;
+    cerr << setw(16) << ( to_string( b.start )+".."+to_string( b.end ) ) << setw(12) << b.count
+         << setw(16) << b.cost << setw(8) << fixed << setprecision(2) << percent( b.cost, total ) << endl;
+  }
+  cerr << setw(16) << "rozkaz" << setw(12) << "wykonania" << setw(16) << "koszt" << setw(8) << "%" << endl;
+  for( int o=0; o<=HALT; o++ )
+    if( opcodes[o].count )
+      cerr << setw(16) << names[o] << setw(12) << opcodes[o].count
+           << setw(16) << opcodes[o].cost << setw(8) << fixed << setprecision(2) << percent( opcodes[o].cost, total ) << endl;
+
+  string base( prefix );
+  ofstream csv( base+".csv" );
+  csv << "pc,rozkaz,argument,wykonania,koszt,blok\n";
+  for( long long k=0; k<n; k++ )
+    csv << k << ',' << names[program[k].first] << ',' << program[k].second << ','
+        << count[k] << ',' << cost[k] << ',' << blocks[blockOf[k]].start << '\n';
+
+  ofstream json( base+".json" );
+  json << "{\n  \"koszt\": " << total << ",\n  \"rozkazy\": {";
+  bool first = true;
+  for( int o=0; o<=HALT; o++ )
+  {
+    if( !opcodes[o].count )
+      continue;
+    json << ( first ? "\n" : ",\n" ) << "    \"" << names[o] << "\": { \"wykonania\": " << opcodes[o].count
+         << ", \"koszt\": " << opcodes[o].cost << " }";
+    first = false;
+  }
+  json << "\n  },\n  \"bloki\": [";
+  for( size_t i=0; i<order.size(); i++ )
+  {
+    Block const & b = blocks[order[i]];
+    json << ( i ? ",\n" : "\n" ) << "    { \"start\": " << b.start << ", \"koniec\": " << b.end
+         << ", \"wykonania\": " << b.count << ", \"koszt\": " << b.cost << " }";
+  }
+  json << "\n  ]\n}\n";
+
+  if( !csv || !json )
+    cerr << cRed << "Błąd: nie można zapisać profilu " << base << ".csv/.json" << cReset << endl;
+}
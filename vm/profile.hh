@@ -0,0 +1,17 @@
+/*
+ * Profil wykonania programu maszyny wirtualnej do projektu z JFTT2024
+ *
+ * run_machine_profiled (mw.cc skompilowane z MW_PROFILE) zapisuje
+ * w mw_profile liczbę wykonań każdego rozkazu. Na tej podstawie liczony
+ * jest koszt każdego rozkazu, bloków podstawowych i rodzajów rozkazów.
+*/
+#pragma once
+
+#include <utility>
+#include <vector>
+
+extern std::vector<long long> mw_profile;
+
+// Raport najdroższych bloków i rozkazów na cerr oraz pliki prefix.csv
+// (każdy rozkaz) i prefix.json (bloki, rodzaje rozkazów).
+void write_profile( std::vector< std::pair<int,long long> > const & program, char const * prefix );